@@ -0,0 +1,136 @@
+/*
+    Latency.ino - Benchmark sketch for LCBUrl - Times setUrl() against
+                  adversarial URLs of growing length and reports the p50,
+                  p99 and maximum parse time for each.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <LCBUrl.h>
+#include <Arduino.h>
+#include <algorithm>
+
+#ifndef BAUD
+#define BAUD 115200
+#endif
+
+// Timed runs per case; with 101 runs p50 and p99 are single samples
+#define RUNS 101
+
+LCBUrl url;
+unsigned long timings[RUNS];
+
+// One hostile pattern: a URL made of prefix, count copies of repeat, and
+// suffix
+struct Case
+{
+    const char *name;
+    const char *prefix;
+    const char *repeat;
+    const char *suffix;
+};
+
+const Case cases[] = {
+    {"Decoded triplets", "http://host/", "%7E", ""},
+    {"Kept triplets", "http://host/", "%2F", ""},
+    {"At signs", "http://", "@", "host/"},
+    {"Colons", "http://", "a:", "@host/"},
+    {"Host labels", "http://", "a.", "com/"},
+    {"Path segments", "http://host", "/./", ""},
+    {"Query pairs", "http://host/?", "k=v&", ""},
+    {"Bad tail", "http://host/", "a", "%G"},
+    {"IPv6 zone", "http://[fe80::1%25", "a", "]/"},
+};
+
+const unsigned int lengths[] = {64, 256, 1024, LCBURL_MAX_LENGTH};
+
+String buildUrl(const Case &thisCase, unsigned int length) // Fill to just under length
+{
+    String retVal = "";
+    retVal.reserve(length);
+    retVal.concat(thisCase.prefix);
+    unsigned int step = strlen(thisCase.repeat);
+    unsigned int tail = strlen(thisCase.suffix);
+    while (retVal.length() + step + tail <= length)
+    {
+        retVal.concat(thisCase.repeat);
+    }
+    retVal.concat(thisCase.suffix);
+    return retVal;
+}
+
+void runCase(const Case &thisCase, unsigned int length)
+{
+    String testUrl = buildUrl(thisCase, length);
+    bool valid = false;
+    for (unsigned int i = 0; i < RUNS; i++)
+    {
+        unsigned long start = micros();
+        valid = url.setUrl(testUrl);
+        timings[i] = micros() - start;
+#ifdef ESP8266
+        yield();
+#endif
+    }
+    std::sort(timings, timings + RUNS);
+
+    Serial.printf("%-18s %6u %6lu %6lu %6lu  %s\n",
+                  thisCase.name,
+                  testUrl.length(),
+                  timings[RUNS / 2],
+                  timings[(RUNS * 99) / 100],
+                  timings[RUNS - 1],
+                  valid ? "valid" : String(url.getErrorString()).c_str());
+}
+
+void setup()
+{
+    Serial.begin(BAUD);
+    Serial.println();
+    Serial.flush();
+    Serial.println("Starting LCBUrl latency run (times in microseconds).");
+    Serial.printf("%-18s %6s %6s %6s %6s  %s\n", "Case", "Length", "p50", "p99", "Max", "Result");
+
+    for (const Case &thisCase : cases)
+    {
+        for (unsigned int length : lengths)
+        {
+            runCase(thisCase, length);
+        }
+    }
+
+    // Anything longer is refused before it is scanned
+    Case tooLong = {"Over the limit", "http://host/", "a", ""};
+    runCase(tooLong, LCBURL_MAX_LENGTH * 2);
+
+    Serial.println("\nLCBUrl latency run complete.");
+}
+
+void loop()
+{
+#ifdef ESP8266
+    yield();
+#endif
+}
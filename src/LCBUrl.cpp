@@ -31,6 +31,9 @@
 
 #include "LCBUrl.h"
 
+#ifdef LCBURL_DEBUG_CHECKS
+#include <assert.h>
+#endif
 
 // The following defines are in the lwip headers. In Arduino 2.x these headers are included by one
 // of the other upstream libraries -- now they are not. This enables us to use these defines without
@@ -56,6 +59,75 @@
 #define IPADDR_BROADCAST    ((uint32_t)0xffffffffUL)
 #endif
 
+// Bootstring parameters for Punycode, from:
+// https://tools.ietf.org/html/rfc3492#section-5
+#define PUNY_BASE 36
+#define PUNY_TMIN 1
+#define PUNY_TMAX 26
+#define PUNY_SKEW 38
+#define PUNY_DAMP 700
+#define PUNY_INITIAL_BIAS 72
+#define PUNY_INITIAL_N 128
+
+// Longest DNS label, in octets or code points
+#define LABEL_MAX 63
+
+// Compact UTS #46 mapping: simple case folding for Latin, Greek, Cyrillic
+// and Armenian as ranges.  Where stride is 2, only every other code point
+// (starting with first) is mapped.  Sorted by first, held in flash.
+struct IDNAMapping
+{
+    uint16_t first;
+    uint16_t last;
+    int16_t delta;
+    uint16_t stride;
+};
+
+static const IDNAMapping idnamappings[] PROGMEM = {
+    {0x00C0, 0x00D6, 32, 1},
+    {0x00D8, 0x00DE, 32, 1},
+    {0x0100, 0x012F, 1, 2},
+    {0x0132, 0x0137, 1, 2},
+    {0x0139, 0x0148, 1, 2},
+    {0x014A, 0x0177, 1, 2},
+    {0x0178, 0x0178, -121, 1},
+    {0x0179, 0x017E, 1, 2},
+    {0x0386, 0x0386, 38, 1},
+    {0x0388, 0x038A, 37, 1},
+    {0x038C, 0x038C, 64, 1},
+    {0x038E, 0x038F, 63, 1},
+    {0x0391, 0x03A1, 32, 1},
+    {0x03A3, 0x03AB, 32, 1},
+    {0x0400, 0x040F, 80, 1},
+    {0x0410, 0x042F, 32, 1},
+    {0x0460, 0x0481, 1, 2},
+    {0x048A, 0x04BF, 1, 2},
+    {0x04D0, 0x04FF, 1, 2},
+    {0x0531, 0x0556, 48, 1},
+    {0x1E00, 0x1E95, 1, 2},
+    {0x1EA0, 0x1EFF, 1, 2},
+};
+
+// Characters left unencoded by percentEncode(), one LCBURL_ENCODE_* bit per
+// component, indexed by ASCII value.  Anything 0x80 and above is encoded.
+static const uint8_t encodemap[128] PROGMEM = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x1F, 0x00, 0x00, 0x1F, 0x00, 0x19, 0x1F, 0x1F, 0x1F, 0x1F, 0x19, 0x1F, 0x1F, 0x1F, 0x17,
+    0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x17, 0x1F, 0x00, 0x1D, 0x00, 0x16,
+    0x17, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F,
+    0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F,
+    0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F,
+    0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x00};
+
+#define ENCODE_KEEP(c, component) ((uint8_t)(c) < 0x80 && (pgm_read_byte(&encodemap[(uint8_t)(c)]) & (component)))
+
+// Code points UTS #46 removes (soft hyphen, joiners, variation selectors)
+static const uint16_t idnaignored[] PROGMEM = {
+    0x00AD, 0x034F, 0x180B, 0x180C, 0x180D, 0x200B, 0x2060, 0xFE00,
+    0xFE01, 0xFE02, 0xFE03, 0xFE04, 0xFE05, 0xFE06, 0xFE07, 0xFE08,
+    0xFE09, 0xFE0A, 0xFE0B, 0xFE0C, 0xFE0D, 0xFE0E, 0xFE0F, 0xFEFF};
+
 // Constructor/Destructor ////////////////////////////////////////////////
 // Handle the creation, setup, and destruction of instances
 
@@ -72,6 +144,14 @@ LCBUrl::LCBUrl(const String &newUrl)
 bool LCBUrl::setUrl(const String &newUrl)
 {
     bool retVal = false;
+    if (newUrl.length() > LCBURL_MAX_LENGTH)
+    {
+        // Refuse oversized input before copying or scanning it
+        initRegisters();
+        parts.error = LCBURL_ERR_TOO_LONG;
+        parts.errorpos = LCBURL_MAX_LENGTH;
+        return retVal;
+    }
     if (!newUrl.isEmpty())
     {
         initRegisters();
@@ -79,612 +159,1513 @@ bool LCBUrl::setUrl(const String &newUrl)
     }
     if (!rawurl.isEmpty())
     {
-        if (!getUrl().isEmpty())
+        // Tokenize once; the getters below only read the component table
+        workingurl = getCleanTriplets();
+        retVal = setParts(LCBUrlTokenizer::parse(workingurl.c_str(), workingurl.length()));
+        if (!retVal)
+            parts.errorpos = getRawPosition(parts.errorpos);
+    }
+    else
+    {
+        parts = LCBUrlParts();
+        parts.error = LCBURL_ERR_EMPTY;
+    }
+    return retVal;
+}
+
+bool LCBUrl::setUrl(const __FlashStringHelper *newUrl) // Parse a URL held in flash without copying it to RAM first
+{
+    PGM_P flash = reinterpret_cast<PGM_P>(newUrl);
+    size_t length = strlen_P(flash);
+    LCBUrlParser parser(*this);
+    parser.begin((length < LCBURL_MAX_LENGTH) ? length : LCBURL_MAX_LENGTH);
+
+    char buffer[32];
+    size_t used = 0;
+#ifdef ESP8266
+    uint32_t word = 0;
+#endif
+    for (size_t index = 0;; index++)
+    {
+#ifdef ESP8266
+        // Flash only allows aligned 32-bit loads, so a word is fetched at a
+        // time and split into bytes (little-endian)
+        uintptr_t address = (uintptr_t)(flash + index);
+        if (index == 0 || (address & 3) == 0)
+            word = pgm_read_dword(reinterpret_cast<const uint32_t *>(address & ~(uintptr_t)3));
+        char c = (char)(word >> (8 * (address & 3)));
+#else
+        char c = (char)pgm_read_byte(flash + index);
+#endif
+        if (c == '\0')
+            break;
+        buffer[used++] = c;
+        if (used == sizeof(buffer))
         {
-            retVal = true;
+            if (!parser.push(buffer, used))
+                return false;
+            used = 0;
         }
     }
-    return retVal;
+    if (!parser.push(buffer, used))
+        return false;
+    return parser.finish();
 }
 
-String LCBUrl::getUrl() // Returned parsed/normalized URL
+String LCBUrl::getUrl() const // Returned parsed/normalized URL
 {
-    return getUrl(false, url);
+    String url_string = "";
+    if (parts.valid)
+        appendUrl(url_string, getAuthority());
+    return url_string;
 }
 
 String LCBUrl::getIPUrl() // Return cleaned URL with IP instead of FQDN
 {
-    return getUrl(true, ipurl);
+    if (ipurl.isEmpty() && parts.valid)
+        appendUrl(ipurl, getIPAuthority());
+    return ipurl;
+}
+
+String LCBUrl::getScheme() const // Returns URL scheme
+{
+    return getSpan(parts.scheme);
+}
+
+String LCBUrl::getUserInfo() const // Return username:passsword
+{
+    // UserInfo will be anything to the left of the last @ in authority
+    return getSpan(parts.userinfo);
+}
+
+String LCBUrl::getUserName() const // Return username from authority
+{
+    // User Name will be anything to the left of the first : in userinfo
+    return getSpan(parts.username);
 }
 
-String LCBUrl::getUrl(bool ipaddr, String &url_string)
+String LCBUrl::getPassword() const // Return password from authority
 {
-    if (url_string.isEmpty())
+    // Password will be anything to the right of the first : in userinfo
+    return getSpan(parts.password);
+}
+
+String LCBUrl::getHost() const // Return FQDN
+{
+    // Host will be anything between @ and : or / in authority, with any
+    // internationalized labels as A-labels ("xn--")
+    if (!asciihost.isEmpty())
+        return asciihost;
+    return getSpan(parts.host);
+}
+
+String LCBUrl::getUnicodeHost() const // Return FQDN with any A-labels as UTF-8
+{
+    if (!unicodehost.isEmpty())
+        return unicodehost;
+    return getSpan(parts.host);
+}
+
+unsigned int LCBUrl::getPort() const // Port from the authority (checked by the tokenizer), or the scheme default
+{
+    // An explicit ":0" is a port too; only an empty one is left out
+    if (parts.port.len != 0)
+        return parts.portnum;
+    return parts.defaultport;
+}
+
+String LCBUrl::getAuthority() const // Returns {username (optional)}:{password (optional)}@{fqdn}
+{
+    String authority_string = "";
+    if (parts.authority)
     {
-        url_string = "";
-        url_string.concat(getScheme());
-        url_string.concat(F("://"));
-        if (ipaddr)
-            url_string.concat(getIPAuthority());
+        if (parts.hosttype == LCBURL_HOST_IPV6)
+            appendAuthority(authority_string, String("[") + getHost() + String("]"));
         else
-            url_string.concat(getAuthority());
-        url_string.concat(F("/"));
-        if (!getPath().isEmpty())
+            appendAuthority(authority_string, getHost());
+    }
+    return authority_string;
+}
+
+String LCBUrl::getIPAuthority() // Returns {username (optional)}:{password (optional)}@{ip_address}
+{
+    if (ipauthority.isEmpty() && parts.authority)
+    {
+        if (parts.hosttype == LCBURL_HOST_IPV6)
         {
-            url_string.concat(getPath());
+            // Already an address, no lookup needed
+            appendAuthority(ipauthority, String("[") + getHost() + String("]"));
         }
-        if (!getQuery().isEmpty())
+        else if (parts.hosttype == LCBURL_HOST_IPV4)
         {
-            url_string.concat(F("?"));
-            url_string.concat(getQuery());
+            ipaddress = IPAddress(parts.address[0], parts.address[1], parts.address[2], parts.address[3]);
+            appendAuthority(ipauthority, getHost());
         }
-        if (getFragment() != "")
+        else if (parts.host.len > 0)
         {
-            url_string.concat(F("#"));
-            url_string.concat(getFragment());
+            ipaddress = getIP(getHost());
+
+            if (ipaddress == (IPAddress)IPADDR_NONE || ipaddress.toString().equalsIgnoreCase("(IP unset)"))
+            {
+                appendAuthority(ipauthority, "255.255.255.255");
+            }
+            else
+            {
+                appendAuthority(ipauthority, ipaddress.toString());
+            }
         }
-        if ((getScheme() == "") || (getHost() == ""))
+        else
         {
-            return url_string;
+            appendAuthority(ipauthority, getHost());
         }
     }
-    return url_string;
+    return ipauthority;
+}
+
+String LCBUrl::getPath() const // Get all after host and port, before query and frag
+{
+    // Path is returned without the leading "/"
+    LCBUrlSpan span = parts.path;
+    if (span.len > 0 && workingurl.charAt(span.pos) == '/')
+    {
+        span.pos++;
+        span.len--;
+    }
+    // TODO: Remove dot segments per 5.2.4
+    return getSpan(span);
+}
+
+String LCBUrl::getAfterPath() const // Get anything after the path
+{
+    String afterpath = "";
+    if (parts.query.pos != 0)
+    {
+        afterpath = workingurl.substring(parts.query.pos - 1);
+    }
+    else if (parts.fragment.pos != 0)
+    {
+        afterpath = workingurl.substring(parts.fragment.pos - 1);
+    }
+    return afterpath;
 }
 
-String LCBUrl::getScheme() // Returns URL scheme
-{                          // Currrently only finds http and https as scheme
-    if (scheme.isEmpty())
+String LCBUrl::getFileName() const
+{
+    // File name is the last path segment, if it contains a "."
+    LCBUrlSpan span = parts.path;
+    for (uint16_t i = span.len; i > 0; i--)
     {
-        scheme = "";
-        int loc = getCleanTriplets().indexOf(F(":"));
-        if (loc > 0)
+        if (workingurl.charAt(parts.path.pos + i - 1) == '/')
         {
-            String s = getCleanTriplets().substring(0, loc);
-            s.toLowerCase();
-            if ((s == F("http")) || (s == F("https")))
-            {
-                scheme = s;
-            }
+            span.pos = parts.path.pos + i;
+            span.len = parts.path.len - i;
+            break;
         }
     }
-    return scheme;
+    String filename = getSpan(span);
+    if (filename.indexOf(".") == -1)
+        filename = "";
+    return filename;
 }
 
-String LCBUrl::getUserInfo() // Return username:passsword
+String LCBUrl::getQuery() const // Get text after '?' and before '#'
 {
-    // UserInfo will be anything to the left of the last @ in authority
-    if (userinfo.isEmpty())
+    return getSpan(parts.query);
+}
+
+String LCBUrl::getFragment() const // Get all after '#'
+{
+    return getSpan(parts.fragment);
+}
+
+uint8_t LCBUrl::getError() const // Why the last URL was rejected, LCBURL_ERR_NONE if it was not
+{
+    return parts.error;
+}
+
+uint16_t LCBUrl::getErrorPosition() const // Offset in the URL as given of the byte which was rejected
+{
+    return parts.errorpos;
+}
+
+uint8_t LCBUrl::getErrorComponent() const // Part of the URL in which the error was found
+{
+    return parts.errorcomponent;
+}
+
+const __FlashStringHelper *LCBUrl::getErrorString() const // Description of getError()
+{
+    switch (parts.error)
     {
-        userinfo = "";
-        String tempUrl = getRawAuthority();
-        if (tempUrl)
+    case LCBURL_ERR_NONE:
+        return F("No error");
+    case LCBURL_ERR_EMPTY:
+        return F("URL is empty");
+    case LCBURL_ERR_SCHEME:
+        return F("Missing or invalid scheme");
+    case LCBURL_ERR_AUTHORITY_REQUIRED:
+        return F("Scheme requires an authority");
+    case LCBURL_ERR_CHARACTER:
+        return F("Invalid character");
+    case LCBURL_ERR_PERCENT:
+        return F("Invalid percent-encoding");
+    case LCBURL_ERR_HOST_EMPTY:
+        return F("Scheme requires a host");
+    case LCBURL_ERR_IP_LITERAL:
+        return F("Invalid IP literal");
+    case LCBURL_ERR_LABEL:
+        return F("Invalid host label");
+    case LCBURL_ERR_HOST_LENGTH:
+        return F("Host name too long");
+    case LCBURL_ERR_PORT:
+        return F("Invalid port");
+    case LCBURL_ERR_PORT_RANGE:
+        return F("Port out of range");
+    case LCBURL_ERR_TOO_LONG:
+        return F("URL too long");
+    case LCBURL_ERR_IDNA:
+        return F("Invalid internationalized host");
+    default:
+        return F("Unknown error");
+    }
+}
+
+bool LCBUrl::nextSegment(LCBUrlView &segment) const // Move segment on to the next path segment, false after the last
+{
+    // Start with an empty view; an empty path is read as "/", one empty segment
+    if (!parts.valid)
+        return false;
+    const char *path = workingurl.c_str() + parts.path.pos;
+    const char *end = path + parts.path.len;
+    const char *start = path;
+    if (segment.str == nullptr)
+    {
+        if (start < end && *start == '/')
+            start++;
+    }
+    else if (segment.str + segment.len >= end)
+    {
+        return false;
+    }
+    else
+    {
+        start = segment.str + segment.len + 1;
+    }
+    const char *stop = start;
+    while (stop < end && *stop != '/')
+        stop++;
+    segment.str = start;
+    segment.len = (uint16_t)(stop - start);
+    return true;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+// Functions only available to other functions in this library
+
+bool LCBUrl::hasEnding(std::string const &fullString, std::string const &ending)
+{
+    if (fullString.length() >= ending.length())
+    {
+        return (0 == fullString.compare(fullString.length() - ending.length(), ending.length(), ending));
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void LCBUrl::appendUrl(String &url_string, const String &authority_string) const // scheme:[//authority]path[?query][#fragment]
+{
+    url_string.concat(getScheme());
+    url_string.concat(F(":"));
+    if (parts.authority)
+    {
+        url_string.concat(F("//"));
+        url_string.concat(authority_string);
+        url_string.concat(F("/"));
+        url_string.concat(getPath());
+    }
+    else
+    {
+        url_string.concat(getSpan(parts.path));
+    }
+    if (parts.query.len > 0)
+    {
+        url_string.concat(F("?"));
+        url_string.concat(getQuery());
+    }
+    if (parts.fragment.len > 0)
+    {
+        url_string.concat(F("#"));
+        url_string.concat(getFragment());
+    }
+}
+
+void LCBUrl::appendAuthority(String &authority_string, const String &host) const // [userinfo@]host[:port]
+{
+    authority_string.concat(getUserName());
+    if (parts.password.len > 0)
+    {
+        authority_string.concat(F(":"));
+        authority_string.concat(getPassword());
+    }
+    if (!authority_string.isEmpty())
+    {
+        authority_string.concat(F("@"));
+    }
+    authority_string.concat(host);
+
+    // Only a non-default port is kept
+    if (parts.port.len != 0 && parts.portnum != parts.defaultport)
+    {
+        authority_string.concat(F(":"));
+        authority_string.concat((unsigned int)parts.portnum);
+    }
+}
+
+String LCBUrl::getDotSegmentsClear()
+{
+    // TODO:  https://tools.ietf.org/html/rfc3986#section-5.2.4
+    return "TODO";
+}
+
+String LCBUrl::getCleanTriplets() // Convert URL encoded triplets
+{
+    // One pass over rawurl: unreserved triplets are decoded, any other
+    // triplet has its hex digits uppercased (RFC3986 section 6.2.2.1).  The
+    // three bytes after a '%' are taken as a unit, so a malformed "%%41"
+    // cannot decode into a new triplet.
+    String clean = "";
+    clean.reserve(rawurl.length());
+    const char *raw = rawurl.c_str();
+    unsigned int len = rawurl.length();
+    for (unsigned int i = 0; i < len; i++)
+    {
+        if (raw[i] == '%' && i + 2 < len)
         {
-            int loc = tempUrl.lastIndexOf(F("@"));
-            if (loc > 0)
+            char character = decodeTriplet(raw[i + 1], raw[i + 2]);
+            if (character != '\0')
             {
-                userinfo = tempUrl.substring(0, loc);
+                clean.concat(character);
             }
+            else
+            {
+                clean.concat('%');
+                for (unsigned int j = i + 1; j < i + 3; j++)
+                    clean.concat(LCBUrlTokenizer::isHexChar(raw[j]) ? LCBUrlTokenizer::toUpperChar(raw[j]) : raw[j]);
+            }
+            i += 2;
+        }
+        else
+        {
+            clean.concat(raw[i]);
         }
     }
-    return userinfo;
+    return clean;
 }
 
-String LCBUrl::getUserName() // Return username from authority
+bool LCBUrl::setParts(const LCBUrlParts &newParts) // Adopt the component table for workingurl and normalize
 {
-    // User Name will be anything to the left of : in userinfo
-    if (username.isEmpty())
+    bool retVal = false;
+    parts = newParts;
+    if (parts.valid)
     {
-        username = "";
-        String tempUrl = getUserInfo();
-        if (tempUrl)
+        // Scheme and host are case-insensitive, normalize to lowercase; the
+        // hex digits of a triplet in the host stay uppercase
+        for (uint16_t i = 0; i < parts.scheme.len; i++)
+            workingurl.setCharAt(parts.scheme.pos + i, LCBUrlTokenizer::toLowerChar(workingurl.charAt(parts.scheme.pos + i)));
+        for (uint16_t i = 0; i < parts.host.len; i++)
+        {
+            if (workingurl.charAt(parts.host.pos + i) == '%')
+                i += 2;
+            else
+                workingurl.setCharAt(parts.host.pos + i, LCBUrlTokenizer::toLowerChar(workingurl.charAt(parts.host.pos + i)));
+        }
+        retVal = true;
+
+        // Convert an internationalized host once, here
+        int aceloc = workingurl.indexOf(F("xn--"), parts.host.pos);
+        if (parts.nonascii)
         {
-            int loc = tempUrl.lastIndexOf(F(":"));
-            if (loc > 0)
+            asciihost = idnaToASCII(getSpan(parts.host).c_str());
+            unicodehost = idnaToUnicode(asciihost.c_str());
+            retVal = !asciihost.isEmpty() && !unicodehost.isEmpty();
+
+            // The tokenizer leaves label rules to the converted name
+            uint8_t error = retVal ? LCBUrlTokenizer::checkHostName(asciihost.c_str(), asciihost.length()) : LCBURL_ERR_NONE;
+            if (error != LCBURL_ERR_NONE)
             {
-                username = tempUrl.substring(0, loc);
+                retVal = false;
+                parts.error = error;
+                parts.errorpos = parts.host.pos;
+                parts.errorcomponent = LCBURL_COMPONENT_HOST;
             }
         }
+        else if (parts.hosttype == LCBURL_HOST_NAME && aceloc != -1 && aceloc < parts.host.pos + parts.host.len)
+        {
+            unicodehost = idnaToUnicode(getSpan(parts.host).c_str());
+            retVal = !unicodehost.isEmpty();
+        }
+        if (!retVal && parts.error == LCBURL_ERR_NONE)
+        {
+            parts.error = LCBURL_ERR_IDNA;
+            parts.errorpos = parts.host.pos;
+            parts.errorcomponent = LCBURL_COMPONENT_HOST;
+        }
     }
-    return username;
+    if (!retVal)
+    {
+        // Keep only the reason
+        uint8_t error = parts.error;
+        uint16_t errorpos = parts.errorpos;
+        uint8_t errorcomponent = parts.errorcomponent;
+        parts = LCBUrlParts();
+        parts.error = error;
+        parts.errorpos = errorpos;
+        parts.errorcomponent = errorcomponent;
+        asciihost = "";
+        unicodehost = "";
+    }
+#ifdef LCBURL_DEBUG_CHECKS
+    else
+        checkParts();
+#endif
+    return retVal;
 }
 
-String LCBUrl::getPassword() // Return password from authority
+#ifdef LCBURL_DEBUG_CHECKS
+void LCBUrl::checkParts() // Assert the component table agrees with workingurl and survives a round trip
 {
-    // Password will be anything to the right of : in userinfo
-    if (password.isEmpty())
+    // Components present are in order, inside the URL, and bounded by
+    // their delimiters
+    const LCBUrlSpan *spans[] = {&parts.userinfo, &parts.host, &parts.port, &parts.path, &parts.query, &parts.fragment};
+    unsigned int end = parts.scheme.pos + parts.scheme.len;
+    assert(parts.scheme.pos == 0 && parts.scheme.len > 0);
+    assert(workingurl.charAt(end) == ':');
+    for (const LCBUrlSpan *span : spans)
+    {
+        if (span->pos == 0)
+            continue;
+        assert(span->pos >= end);
+        end = span->pos + span->len;
+        assert(end <= workingurl.length());
+    }
+    if (parts.userinfo.pos != 0)
+        assert(workingurl.charAt(parts.userinfo.pos + parts.userinfo.len) == '@');
+    if (parts.port.pos != 0)
+        assert(workingurl.charAt(parts.port.pos - 1) == ':');
+    if (parts.query.pos != 0)
+        assert(workingurl.charAt(parts.query.pos - 1) == '?');
+    if (parts.fragment.pos != 0)
+        assert(workingurl.charAt(parts.fragment.pos - 1) == '#');
+
+    // The port number is the port span
+    uint32_t port = 0;
+    for (uint16_t i = 0; i < parts.port.len; i++)
+        port = port * 10 + (uint32_t)(workingurl.charAt(parts.port.pos + i) - '0');
+    assert(port == parts.portnum);
+
+    // getUrl() splits into the same components again (an empty password or
+    // userinfo is dropped by getAuthority())
+    String normal = getUrl();
+    LCBUrlParts again = LCBUrlTokenizer::parse(normal.c_str(), normal.length());
+    assert(again.valid);
+    assert(normal.substring(again.scheme.pos, again.scheme.pos + again.scheme.len) == getScheme());
+    assert(normal.substring(again.username.pos, again.username.pos + again.username.len) == getUserName());
+    assert(normal.substring(again.password.pos, again.password.pos + again.password.len) == getPassword());
+    assert(normal.substring(again.host.pos, again.host.pos + again.host.len) == getHost());
+    assert(((again.port.len != 0) ? again.portnum : again.defaultport) == getPort());
+    String path = "";
+    if (parts.authority)
     {
-        password = "";
-        String tempUrl = getUserInfo();
-        if (tempUrl)
+        path.concat('/');
+        path.concat(getPath());
+    }
+    else
+        path = getSpan(parts.path);
+    assert(normal.substring(again.path.pos, again.path.pos + again.path.len) == path);
+    assert(normal.substring(again.query.pos, again.query.pos + again.query.len) == getQuery());
+    assert(normal.substring(again.fragment.pos, again.fragment.pos + again.fragment.len) == getFragment());
+}
+#endif
+
+char LCBUrl::decodeTriplet(char hi, char lo) // Character for "%XY" if it is unreserved, otherwise '\0'
+{
+    if (!LCBUrlTokenizer::isHexChar(hi) || !LCBUrlTokenizer::isHexChar(lo))
+        return '\0';
+    hi = LCBUrlTokenizer::toLowerChar(hi);
+    lo = LCBUrlTokenizer::toLowerChar(lo);
+    char character = (char)(((LCBUrlTokenizer::isDigitChar(hi) ? hi - '0' : hi - 'a' + 10) << 4) |
+                            (LCBUrlTokenizer::isDigitChar(lo) ? lo - '0' : lo - 'a' + 10));
+    return LCBUrlTokenizer::isUnreservedChar(character) ? character : '\0';
+}
+
+uint16_t LCBUrl::getRawPosition(uint16_t position) // Map an offset in workingurl back to rawurl
+{
+    // getCleanTriplets() turned each unreserved "%XY" into one character
+    // and kept any other '%' and the two bytes after it as a unit
+    unsigned int raw = 0;
+    unsigned int len = rawurl.length();
+    uint16_t working = 0;
+    while (working < position && raw < len)
+    {
+        if (rawurl.charAt(raw) == '%' && raw + 2 < len &&
+            decodeTriplet(rawurl.charAt(raw + 1), rawurl.charAt(raw + 2)) != '\0')
+        {
+            raw += 3;
+            working++;
+        }
+        else if (rawurl.charAt(raw) == '%' && raw + 2 < len)
         {
-            int loc = tempUrl.lastIndexOf(F(":"));
-            if (loc > 0)
+            uint16_t step = (position - working < 3) ? position - working : 3;
+            raw += step;
+            working += step;
+        }
+        else
+        {
+            raw++;
+            working++;
+        }
+    }
+    return (uint16_t)raw;
+}
+
+String LCBUrl::getSpan(const LCBUrlSpan &span) const // Copy one component out of the working URL
+{
+    if (span.len == 0)
+        return String("");
+    return workingurl.substring(span.pos, span.pos + span.len);
+}
+
+uint32_t LCBUrl::decodeUTF8(const char *str, size_t len, size_t &index) // Next code point, UINT32_MAX if malformed
+{
+    uint8_t lead = (uint8_t)str[index++];
+    if (lead < 0x80)
+        return lead;
+
+    uint8_t extra = 0;
+    uint32_t codepoint = 0;
+    uint32_t minimum = 0;
+    if ((lead & 0xE0) == 0xC0)
+    {
+        extra = 1;
+        codepoint = lead & 0x1F;
+        minimum = 0x80;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        extra = 2;
+        codepoint = lead & 0x0F;
+        minimum = 0x800;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        extra = 3;
+        codepoint = lead & 0x07;
+        minimum = 0x10000;
+    }
+    else
+        return UINT32_MAX;
+
+    for (uint8_t i = 0; i < extra; i++)
+    {
+        if (index >= len || ((uint8_t)str[index] & 0xC0) != 0x80)
+            return UINT32_MAX;
+        codepoint = (codepoint << 6) | ((uint8_t)str[index++] & 0x3F);
+    }
+    // Reject overlong forms, surrogates and values past Unicode
+    if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        return UINT32_MAX;
+    return codepoint;
+}
+
+void LCBUrl::appendUTF8(String &output, uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        output.concat((char)codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        output.concat((char)(0xC0 | (codepoint >> 6)));
+        output.concat((char)(0x80 | (codepoint & 0x3F)));
+    }
+    else if (codepoint < 0x10000)
+    {
+        output.concat((char)(0xE0 | (codepoint >> 12)));
+        output.concat((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+        output.concat((char)(0x80 | (codepoint & 0x3F)));
+    }
+    else
+    {
+        output.concat((char)(0xF0 | (codepoint >> 18)));
+        output.concat((char)(0x80 | ((codepoint >> 12) & 0x3F)));
+        output.concat((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+        output.concat((char)(0x80 | (codepoint & 0x3F)));
+    }
+}
+
+uint32_t LCBUrl::mapCodePoint(uint32_t codepoint) // UTS #46 mapping, 0 if the code point is removed
+{
+    if (codepoint < 0x80)
+        return (uint32_t)LCBUrlTokenizer::toLowerChar((char)codepoint);
+    if (codepoint >= 0xFF01 && codepoint <= 0xFF5E)
+        // Fullwidth ASCII
+        return (uint32_t)LCBUrlTokenizer::toLowerChar((char)(codepoint - 0xFEE0));
+    if (codepoint == 0x3002 || codepoint == 0xFF0E || codepoint == 0xFF61)
+        // Ideographic and fullwidth full stops separate labels
+        return '.';
+    if (codepoint > 0xFFFF)
+        return codepoint;
+
+    for (size_t i = 0; i < sizeof(idnaignored) / sizeof(idnaignored[0]); i++)
+    {
+        if (pgm_read_word(&idnaignored[i]) == codepoint)
+            return 0;
+    }
+    for (size_t i = 0; i < sizeof(idnamappings) / sizeof(idnamappings[0]); i++)
+    {
+        uint16_t first = pgm_read_word(&idnamappings[i].first);
+        if (codepoint < first)
+            break;
+        if (codepoint <= pgm_read_word(&idnamappings[i].last))
+        {
+            uint16_t stride = pgm_read_word(&idnamappings[i].stride);
+            if ((codepoint - first) % stride == 0)
+                return codepoint + (int16_t)pgm_read_word(&idnamappings[i].delta);
+            break;
+        }
+    }
+    return codepoint;
+}
+
+static uint32_t punycodeAdapt(uint32_t delta, uint32_t numpoints, bool firsttime) // RFC3492 section 6.1
+{
+    delta = firsttime ? delta / PUNY_DAMP : delta / 2;
+    delta += delta / numpoints;
+    uint32_t k = 0;
+    while (delta > ((PUNY_BASE - PUNY_TMIN) * PUNY_TMAX) / 2)
+    {
+        delta /= PUNY_BASE - PUNY_TMIN;
+        k += PUNY_BASE;
+    }
+    return k + (((PUNY_BASE - PUNY_TMIN + 1) * delta) / (delta + PUNY_SKEW));
+}
+
+static uint32_t punycodeThreshold(uint32_t k, uint32_t bias)
+{
+    if (k <= bias)
+        return PUNY_TMIN;
+    if (k >= bias + PUNY_TMAX)
+        return PUNY_TMAX;
+    return k - bias;
+}
+
+static char punycodeDigit(uint32_t digit)
+{
+    return (char)(digit < 26 ? 'a' + digit : '0' + digit - 26);
+}
+
+bool LCBUrl::punycodeEncode(const uint32_t *input, size_t length, String &output) // RFC3492 section 6.3
+{
+    uint32_t handled = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (input[i] < 0x80)
+        {
+            output.concat((char)input[i]);
+            handled++;
+        }
+    }
+    uint32_t basic = handled;
+    if (basic > 0)
+        output.concat('-');
+
+    uint32_t n = PUNY_INITIAL_N;
+    uint32_t delta = 0;
+    uint32_t bias = PUNY_INITIAL_BIAS;
+    while (handled < length)
+    {
+        uint32_t m = UINT32_MAX;
+        for (size_t i = 0; i < length; i++)
+        {
+            if (input[i] >= n && input[i] < m)
+                m = input[i];
+        }
+        if (m - n > (UINT32_MAX - delta) / (handled + 1))
+            return false;
+        delta += (m - n) * (handled + 1);
+        n = m;
+        for (size_t i = 0; i < length; i++)
+        {
+            if (input[i] < n && ++delta == 0)
+                return false;
+            if (input[i] == n)
             {
-                password = tempUrl.substring(loc + 1);
+                uint32_t q = delta;
+                for (uint32_t k = PUNY_BASE;; k += PUNY_BASE)
+                {
+                    uint32_t t = punycodeThreshold(k, bias);
+                    if (q < t)
+                        break;
+                    output.concat(punycodeDigit(t + (q - t) % (PUNY_BASE - t)));
+                    q = (q - t) / (PUNY_BASE - t);
+                }
+                output.concat(punycodeDigit(q));
+                bias = punycodeAdapt(delta, handled + 1, handled == basic);
+                delta = 0;
+                handled++;
             }
         }
+        delta++;
+        n++;
     }
-    return password;
+    return true;
 }
 
-String LCBUrl::getHost() // Return FQDN
+bool LCBUrl::punycodeDecode(const char *input, size_t length, uint32_t *output, size_t &count) // RFC3492 section 6.2, output holds LABEL_MAX
 {
-    // Host will be anything between @ and : or / in authority
-    if (host.isEmpty())
+    // Basic code points are those before the last delimiter
+    size_t basic = 0;
+    bool delimiter = false;
+    for (size_t i = 0; i < length; i++)
     {
-        host = "";
-        String tempUrl = getRawAuthority();
-        if (tempUrl)
+        if (input[i] == '-')
         {
-            int startloc = tempUrl.lastIndexOf(F("@"));
-            if (startloc > 0)
+            basic = i;
+            delimiter = true;
+        }
+    }
+    count = 0;
+    for (size_t i = 0; i < basic; i++)
+    {
+        if ((uint8_t)input[i] >= 0x80 || count >= LABEL_MAX)
+            return false;
+        output[count++] = (uint8_t)input[i];
+    }
+
+    uint32_t n = PUNY_INITIAL_N;
+    uint32_t i = 0;
+    uint32_t bias = PUNY_INITIAL_BIAS;
+    for (size_t in = delimiter ? basic + 1 : 0; in < length;)
+    {
+        uint32_t oldi = i;
+        uint32_t w = 1;
+        for (uint32_t k = PUNY_BASE;; k += PUNY_BASE)
+        {
+            if (in >= length)
+                return false;
+            char c = LCBUrlTokenizer::toLowerChar(input[in++]);
+            uint32_t digit = PUNY_BASE;
+            if (c >= 'a' && c <= 'z')
+                digit = (uint32_t)(c - 'a');
+            else if (c >= '0' && c <= '9')
+                digit = (uint32_t)(c - '0' + 26);
+            if (digit >= PUNY_BASE || digit > (UINT32_MAX - i) / w)
+                return false;
+            i += digit * w;
+            uint32_t t = punycodeThreshold(k, bias);
+            if (digit < t)
+                break;
+            if (w > UINT32_MAX / (PUNY_BASE - t))
+                return false;
+            w *= PUNY_BASE - t;
+        }
+        bias = punycodeAdapt(i - oldi, (uint32_t)count + 1, oldi == 0);
+        if (i / (count + 1) > UINT32_MAX - n)
+            return false;
+        n += i / (count + 1);
+        i %= (count + 1);
+        if (count >= LABEL_MAX || n < 0x80 || n > 0x10FFFF)
+            return false;
+        for (size_t j = count; j > i; j--)
+            output[j] = output[j - 1];
+        output[i++] = n;
+        count++;
+    }
+    return true;
+}
+
+void LCBUrl::appendEncoded(String &output, const char *str, uint8_t component) // Caller reserves the space
+{
+    static const char hex[] = "0123456789ABCDEF";
+    // Encode in chunks on the stack, then copy each chunk in one concat()
+    char chunk[64];
+    size_t used = 0;
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (used > sizeof(chunk) - 4)
+        {
+            chunk[used] = '\0';
+            output.concat(chunk);
+            used = 0;
+        }
+        if (ENCODE_KEEP(*c, component))
+        {
+            chunk[used++] = *c;
+        }
+        else
+        {
+            chunk[used++] = '%';
+            chunk[used++] = hex[(uint8_t)*c >> 4];
+            chunk[used++] = hex[(uint8_t)*c & 0x0F];
+        }
+    }
+    chunk[used] = '\0';
+    output.concat(chunk);
+}
+
+void LCBUrl::initRegisters() // Clear out the internals to allow the object to be re-used
+{
+    rawurl = "";
+    workingurl = "";
+    parts = LCBUrlParts();
+    asciihost = "";
+    unicodehost = "";
+    ipurl = "";
+    ipaddress = IPADDR_NONE;
+    ipauthority = "";
+}
+
+// LCBUrlParser Methods ///////////////////////////////////////////////////////
+// Feed a URL into an LCBUrl in pieces, as it arrives
+
+LCBUrlParser::LCBUrlParser(LCBUrl &target) : url(target)
+{
+    begin();
+}
+
+void LCBUrlParser::begin(size_t expected) // Start a new URL, optionally reserving space for it
+{
+    url.initRegisters();
+    tokenizer = LCBUrlTokenizer();
+    pending = 0;
+    decodes.clear();
+    failed = false;
+    reserved = expected;
+    if (expected > 0)
+        url.workingurl.reserve(expected);
+}
+
+bool LCBUrlParser::push(char c)
+{
+    return push(&c, 1);
+}
+
+bool LCBUrlParser::push(const char *data, size_t len) // Add the next piece of the URL
+{
+    if (failed)
+        return false;
+    if (url.workingurl.length() + 2 * decodes.size() + pending + len > LCBURL_MAX_LENGTH)
+    {
+        // Refuse oversized input before buffering or scanning it
+        LCBUrlParts error;
+        error.error = LCBURL_ERR_TOO_LONG;
+        error.errorpos = LCBURL_MAX_LENGTH;
+        reject(error);
+        return false;
+    }
+
+    // Grow geometrically so byte-sized pieces do not realloc every time
+    size_t needed = url.workingurl.length() + len;
+    if (needed > reserved)
+    {
+        reserved = (needed > reserved * 2) ? needed : reserved * 2;
+        url.workingurl.reserve(reserved);
+    }
+
+    char chunk[64];
+    size_t used = 0;
+    for (size_t i = 0; i < len && !failed; i++)
+    {
+        char c = data[i];
+        if (pending > 0 || c == '%')
+        {
+            // Percent-encoded triplet, which may be split across pieces
+            triplet[pending++] = c;
+            if (pending < 3)
+                continue;
+            pending = 0;
+            char decoded = url.decodeTriplet(triplet[1], triplet[2]);
+            if (decoded != '\0')
             {
-                tempUrl = tempUrl.substring(startloc + 1, tempUrl.length());
+                decodes.push_back((uint16_t)(url.workingurl.length() + used));
+                failed = !emit(chunk, used, decoded);
             }
-            int endloc = tempUrl.indexOf(F(":"), 0);
-            if (endloc > 0)
+            else
             {
-                tempUrl = tempUrl.substring(0, endloc);
+                // Kept encoded, with uppercase hex digits as in setUrl()
+                failed = !emit(chunk, used, triplet[0]);
+                for (uint8_t j = 1; j < 3 && !failed; j++)
+                    failed = !emit(chunk, used, LCBUrlTokenizer::isHexChar(triplet[j]) ? LCBUrlTokenizer::toUpperChar(triplet[j]) : triplet[j]);
             }
-            host = tempUrl;
         }
+        else
+        {
+            failed = !emit(chunk, used, c);
+        }
+    }
+    chunk[used] = '\0';
+    url.workingurl.concat(chunk);
+    if (failed)
+    {
+        LCBUrlParts error = tokenizer.getParts();
+        error.errorpos = getRawPosition(error.errorpos);
+        reject(error);
+    }
+    return !failed;
+}
+
+bool LCBUrlParser::finish() // End of the URL, the target is ready to use if true
+{
+    if (failed)
+        return false;
+
+    // A triplet cut short by the end of the URL is passed on as it is
+    for (uint8_t i = 0; i < pending; i++)
+    {
+        url.workingurl.concat(triplet[i]);
+        tokenizer.push(triplet[i]);
+    }
+    pending = 0;
+    if (!tokenizer.finish())
+    {
+        LCBUrlParts error = tokenizer.getParts();
+        error.errorpos = getRawPosition(error.errorpos);
+        reject(error);
+        return false;
+    }
+    failed = !url.setParts(tokenizer.getParts());
+    if (failed)
+        url.parts.errorpos = getRawPosition(url.parts.errorpos);
+    return !failed;
+}
+
+void LCBUrlParser::reject(const LCBUrlParts &error) // Stop, leaving only the reason in the target
+{
+    failed = true;
+    url.setParts(error);
+}
+
+uint16_t LCBUrlParser::getRawPosition(uint16_t position) const // Map an offset in the target back to the bytes as pushed
+{
+    // Each triplet decoded before position took two more bytes as pushed
+    size_t low = 0;
+    size_t high = decodes.size();
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (decodes[middle] < position)
+            low = middle + 1;
+        else
+            high = middle;
     }
-    host.toLowerCase();
-    return host;
+    return (uint16_t)(position + 2 * low);
+}
+
+bool LCBUrlParser::emit(char *chunk, size_t &used, char c) // Tokenize one byte and queue it for the target
+{
+    if (used == 63)
+    {
+        chunk[used] = '\0';
+        url.workingurl.concat(chunk);
+        used = 0;
+    }
+    chunk[used++] = c;
+    return tokenizer.push(c);
+}
+
+// LCBUrlRouter Methods ///////////////////////////////////////////////////////
+// Dispatch on the path of a parsed URL
+
+static int compareText(const LCBUrlView &a, const LCBUrlView &b) // Order of trie children
+{
+    uint16_t len = (a.len < b.len) ? a.len : b.len;
+    int retVal = (len > 0) ? memcmp(a.str, b.str, len) : 0;
+    if (retVal == 0)
+        retVal = (int)a.len - (int)b.len;
+    return retVal;
 }
 
-unsigned int LCBUrl::getPort() // Port will be any integer between : and / in authority
+// Binary search of trie children sorted by compareText(); textOf(child)
+// returns the text of a child.  Returns the child, or 0 with index set to
+// where it would be inserted.
+template <typename Child, typename TextOf>
+static Child findSorted(const std::vector<Child> &children, const LCBUrlView &text, size_t &index, TextOf textOf)
 {
-    if (port == 0)
+    size_t low = 0;
+    size_t high = children.size();
+    while (low < high)
     {
-        String tempUrl = getRawAuthority();
-        if (!tempUrl.isEmpty())
+        size_t middle = (low + high) / 2;
+        int order = compareText(textOf(children[middle]), text);
+        if (order == 0)
         {
-            int startloc = tempUrl.lastIndexOf(F(":"));
-            int endloc = tempUrl.lastIndexOf(F("/"));
-            if (startloc != -1)
-                tempUrl = tempUrl.substring(startloc + 1);
-            if (endloc != -1)
-                tempUrl = tempUrl.substring(0, endloc - 1);
-            if (startloc != -1)
-                port = tempUrl.toInt();
+            index = middle;
+            return children[middle];
         }
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
     }
-    if (port == 0)
+    index = low;
+    return 0;
+}
+
+bool LCBUrlView::equals(const char *text) const // Same bytes as the terminated text
+{
+    for (uint16_t i = 0; i < len; i++)
     {
-        if (getScheme() == F("http"))
-            port = 80;
-        if (getScheme() == F("https"))
-            port = 443;
+        if (text[i] != str[i])
+            return false;
     }
-    return port;
+    return text[len] == '\0';
 }
 
-String LCBUrl::getAuthority() // Returns {username (optional)}:{password (optional)}@{fqdn}
+String LCBUrlView::toString() const
 {
-    return getAuthority(false, authority);
+    String retVal = "";
+    retVal.reserve(len);
+    for (uint16_t i = 0; i < len; i++)
+    {
+        retVal.concat(str[i]);
+    }
+    return retVal;
 }
 
-String LCBUrl::getIPAuthority() // Returns {username (optional)}:{password (optional)}@{ip_address}
+LCBUrlRouter::LCBUrlRouter()
 {
-    return getAuthority(true, ipauthority);
+    nodes.push_back(Node()); // Root, before the first segment
 }
 
-String LCBUrl::getAuthority(bool ipaddr, String &authority_string)
+bool LCBUrlRouter::addRoute(const char *pattern, int route) // Add "/path/:name/*name", false if malformed or already routed
 {
-    if (authority_string.isEmpty())
+    if (pattern == nullptr || route < 0)
+        return false;
+    const char *start = (*pattern == '/') ? pattern + 1 : pattern;
+    uint16_t node = 0;
+    for (uint8_t depth = 1;; depth++)
     {
-        authority_string = "";
-        if (!getUserName().isEmpty())
-        {
-            authority_string = getUserName();
-        }
-        if (!getPassword().isEmpty())
-        {
-            authority_string.concat(F(":"));
-            authority_string.concat(getPassword());
-        }
-        if (!authority_string.isEmpty())
-        {
-            authority_string.concat(F("@"));
-        }
-        if (ipaddr)
-        {
-            ipaddress = getIP(getHost());
+        const char *stop = start;
+        while (*stop != '\0' && *stop != '/')
+            stop++;
+        if (depth > LCBURL_ROUTE_DEPTH || nodes.size() >= UINT16_MAX)
+            return false;
 
-            if (ipaddress == (IPAddress)IPADDR_NONE || ipaddress.toString().equalsIgnoreCase("(IP unset)"))
+        LCBUrlView segment;
+        segment.str = start;
+        segment.len = (uint16_t)(stop - start);
+        uint16_t next = 0;
+        if (segment.len > 0 && (*start == ':' || *start == '*'))
+        {
+            // Capture, one per kind at each level, with a single name
+            bool wildcard = (*start == '*');
+            if (wildcard && *stop != '\0')
+                return false; // Only the last segment may take the rest
+            segment.str++;
+            segment.len--;
+            next = wildcard ? nodes[node].wildcard : nodes[node].param;
+            if (next == 0)
             {
-                authority_string.concat("255.255.255.255");
+                next = (uint16_t)nodes.size();
+                nodes.push_back(Node());
+                nodes[next].text = segment;
+                if (wildcard)
+                    nodes[node].wildcard = next;
+                else
+                    nodes[node].param = next;
             }
-            else
+            else if (compareText(nodes[next].text, segment) != 0)
             {
-                authority_string.concat(ipaddress.toString());
+                return false;
             }
         }
         else
         {
-            authority.concat(getHost());
-        }
-
-        if (getPort() > 0)
-        {
-            if (
-                ((getScheme() == F("http")) && (port != 80)) ||
-                ((getScheme() == F("https")) && (port != 443)))
+            size_t index = 0;
+            next = findChild(nodes[node], segment, index);
+            if (next == 0)
             {
-                authority_string.concat(F(":"));
-                authority_string.concat(String(getPort()));
+                next = (uint16_t)nodes.size();
+                nodes.push_back(Node());
+                nodes[next].text = segment;
+                nodes[node].children.insert(nodes[node].children.begin() + index, next);
             }
         }
+        node = next;
+        if (*stop == '\0')
+            break;
+        start = stop + 1;
     }
-    return authority_string;
+    if (nodes[node].route >= 0)
+        return false;
+    nodes[node].route = route;
+    return true;
+}
+
+int LCBUrlRouter::match(const LCBUrl &url) const // Route for the path of url, -1 if none
+{
+    uint8_t count = 0;
+    return match(url, nullptr, 0, count);
 }
 
-String LCBUrl::getPath() // Get all after host and port, before query and frag
+int LCBUrlRouter::match(const LCBUrl &url, LCBUrlParam *params, uint8_t size, uint8_t &count) const // As match(), also filling up to size captures
 {
-    if (path.isEmpty())
+    // Segments past LCBURL_ROUTE_DEPTH are not kept, only a "*name" can
+    // take them
+    Path path;
+    LCBUrlView segment;
+    count = 0;
+    while (url.nextSegment(segment))
     {
-        if (!getPathSegmentNoFile().isEmpty())
-        {
-            path = getPathSegmentNoFile();
-            if (!getFileName().isEmpty())
-            {
-                path.concat(F("/"));
-                path.concat(getFileName());
-            }
-        }
-        path = getPathSegment();
-        // TODO: Remove dot segments per 5.2.4
+        if (path.count < LCBURL_ROUTE_DEPTH)
+            path.segments[path.count++] = segment;
+        else if (path.rest == nullptr)
+            path.rest = segment.str;
+        path.end = segment.str + segment.len;
     }
-    return path;
+    if (path.count == 0)
+        return -1;
+    return matchNode(0, path, 0, params, size, count);
 }
 
-String LCBUrl::getFileName()
+uint16_t LCBUrlRouter::findChild(const Node &node, const LCBUrlView &segment, size_t &index) const // Binary search of the literal children
 {
-    if (filename.isEmpty())
-    {
-        String tempUrl = getStripScheme();
+    return findSorted(node.children, segment, index, [this](uint16_t child) { return nodes[child].text; });
+}
 
-        int startloc = tempUrl.lastIndexOf(F("/"));
-        if (startloc > 0)
-        {
-            tempUrl = tempUrl.substring(startloc + 1);
-        }
-        else
-        {
-            tempUrl = "";
-        }
+int LCBUrlRouter::matchNode(uint16_t node, const Path &path, uint8_t depth, LCBUrlParam *params, uint8_t size, uint8_t &found) const
+{
+    const Node &current = nodes[node];
+    if (depth == path.count && path.rest == nullptr)
+        return current.route;
 
-        int endloc = tempUrl.lastIndexOf(F("?"));
-        if (endloc != -1)
+    // Literal, then ":name", then "*name"
+    const uint8_t saved = found;
+    if (depth < path.count)
+    {
+        size_t index = 0;
+        uint16_t child = findChild(current, path.segments[depth], index);
+        if (child != 0)
         {
-            tempUrl = tempUrl.substring(0, endloc);
+            int route = matchNode(child, path, depth + 1, params, size, found);
+            if (route >= 0)
+                return route;
+            found = saved;
         }
-        else
+        if (current.param != 0 && path.segments[depth].len > 0)
         {
-            int endloc = tempUrl.lastIndexOf(F("#"));
-            if (endloc != -1)
+            if (found < size)
             {
-                tempUrl = tempUrl.substring(0, endloc - 1);
+                params[found].name = nodes[current.param].text;
+                params[found].value = path.segments[depth];
+                found++;
             }
+            int route = matchNode(current.param, path, depth + 1, params, size, found);
+            if (route >= 0)
+                return route;
+            found = saved;
         }
-        if (tempUrl.indexOf(".") != -1)
-            filename = tempUrl;
     }
-    return filename;
+    if (current.wildcard != 0 && nodes[current.wildcard].route >= 0)
+    {
+        if (found < size)
+        {
+            const char *start = (depth < path.count) ? path.segments[depth].str : path.rest;
+            params[found].name = nodes[current.wildcard].text;
+            params[found].value.str = start;
+            params[found].value.len = (uint16_t)(path.end - start);
+            found++;
+        }
+        return nodes[current.wildcard].route;
+    }
+    return -1;
+}
+
+// LCBUrlFilter Methods ///////////////////////////////////////////////////////
+// Allow/deny list matching on the parsed components
+
+// Host root and path root; no child is ever 0 or 1, so 0 means "none"
+#define FILTER_HOST_ROOT 0
+#define FILTER_PATH_ROOT 1
+
+static bool previousLabel(const char *fqdn, size_t len, LCBUrlView &label) // Move label (start empty) one label to the left, false after the first
+{
+    // Empty labels, as in a trailing root ".", are skipped
+    const char *stop = (label.str == nullptr) ? fqdn + len : label.str;
+    while (stop > fqdn && *(stop - 1) == '.')
+        stop--;
+    if (stop == fqdn)
+        return false;
+    const char *start = stop;
+    while (start > fqdn && *(start - 1) != '.')
+        start--;
+    label.str = start;
+    label.len = (uint16_t)(stop - start);
+    return true;
+}
+
+LCBUrlFilter::LCBUrlFilter(size_t bloombits)
+{
+    nodes.push_back(Node()); // Host root
+    nodes.push_back(Node()); // Path root
+    bloom.assign((bloombits + 7) / 8, 0);
+}
+
+bool LCBUrlFilter::addHost(const char *suffix, int rule) // Add "example.com" for itself and its subdomains, false if empty or already added
+{
+    if (suffix == nullptr || rule < 0)
+        return false;
+    if (suffix[0] == '*' && suffix[1] == '.')
+        suffix += 2;
+    else if (suffix[0] == '.')
+        suffix++;
+    if (strlen(suffix) > LCBURL_MAX_LENGTH)
+        return false;
+
+    // Hosts are compared as setUrl() leaves them: lower case, with any
+    // internationalized labels as A-labels
+    LCBUrl converter;
+    String host = converter.idnaToASCII(suffix);
+    uint32_t node = FILTER_HOST_ROOT;
+    LCBUrlView label;
+    while (previousLabel(host.c_str(), host.length(), label))
+        node = addChild(node, label);
+    if (node == FILTER_HOST_ROOT || nodes[node].rule >= 0)
+        return false;
+    nodes[node].rule = rule;
+    return true;
 }
 
-String LCBUrl::getQuery() // Get text after '?' and before '#'
+bool LCBUrlFilter::addPath(const char *prefix, int rule) // Add "/path" for itself and everything below it, false if already added
 {
-    if (query.isEmpty())
+    if (prefix == nullptr || rule < 0)
+        return false;
+    if (strlen(prefix) > LCBURL_MAX_LENGTH)
+        return false;
+
+    // Paths are compared as setUrl() leaves them, with triplets cleaned
+    LCBUrl converter;
+    converter.rawurl = prefix;
+    String path = converter.getCleanTriplets();
+    const char *start = (path.charAt(0) == '/') ? path.c_str() + 1 : path.c_str();
+    uint32_t node = FILTER_PATH_ROOT;
+    while (*start != '\0')
     {
-        query = "";
-        String tempUrl = getAfterPath();
-        int queryloc = tempUrl.lastIndexOf(F("#"));
-        if (tempUrl.startsWith(F("?")))
-            query = tempUrl.substring(1, queryloc);
-        else
-            query = tempUrl.substring(0, queryloc);
+        const char *stop = start;
+        while (*stop != '\0' && *stop != '/')
+            stop++;
+
+        // A trailing "/" adds no segment: "/api/" is the same as "/api"
+        LCBUrlView segment;
+        segment.str = start;
+        segment.len = (uint16_t)(stop - start);
+        if (stop > start || *stop != '\0')
+            node = addChild(node, segment);
+        if (*stop == '\0')
+            break;
+        start = stop + 1;
     }
-    return query;
+    if (nodes[node].rule >= 0)
+        return false;
+    nodes[node].rule = rule;
+    return true;
 }
 
-String LCBUrl::getFragment() // Get all after '#'
+bool LCBUrlFilter::addUrl(const char *url) // Add an exact URL, false if it does not parse
 {
-    if (fragment.isEmpty())
+    LCBUrl entry;
+    if (url == nullptr || !entry.setUrl(url))
+        return false;
+    String normal = entry.getUrl();
+    size_t index = 0;
+    if (findUrl(normal.c_str(), index))
+        return true;
+
+    if (!bloom.empty())
     {
-        fragment = "";
-        String tempUrl = getAfterPath();
-        int fragloc = tempUrl.lastIndexOf(F("#"));
-        if (fragloc != -1)
+        uint64_t value = hash(normal.c_str(), normal.length());
+        for (uint8_t i = 0; i < LCBURL_BLOOM_HASHES; i++)
         {
-            fragment = tempUrl.substring(fragloc + 1);
+            size_t bit = bloomBit(value, i);
+            bloom[bit / 8] |= (uint8_t)(1 << (bit % 8));
         }
     }
-    return fragment;
+    urls.insert(urls.begin() + index, normal);
+    return true;
 }
 
-// Private Methods /////////////////////////////////////////////////////////////
-// Functions only available to other functions in this library
-
-bool LCBUrl::hasEnding(std::string const &fullString, std::string const &ending)
+int LCBUrlFilter::matchHost(const LCBUrl &url) const // Rule of the longest suffix of the host of url, -1 if none
 {
-    if (fullString.length() >= ending.length())
+    if (!url.parts.valid)
+        return -1;
+    const char *host;
+    size_t len;
+    if (!url.asciihost.isEmpty())
     {
-        return (0 == fullString.compare(fullString.length() - ending.length(), ending.length(), ending));
+        host = url.asciihost.c_str();
+        len = url.asciihost.length();
     }
     else
     {
-        return false;
+        host = url.workingurl.c_str() + url.parts.host.pos;
+        len = url.parts.host.len;
+    }
+
+    // An IP literal only matches as a whole, never by suffix
+    bool whole = (url.parts.hosttype != LCBURL_HOST_NAME);
+    int retVal = -1;
+    int last = -1;
+    uint32_t node = FILTER_HOST_ROOT;
+    LCBUrlView label;
+    while (previousLabel(host, len, label))
+    {
+        size_t index = 0;
+        node = findChild(node, label, index);
+        if (node == 0)
+            return retVal;
+        last = nodes[node].rule;
+        if (!whole && last >= 0)
+            retVal = last;
     }
+    return whole ? last : retVal;
 }
 
-String LCBUrl::getStripScheme() // Remove scheme and "://" discriminately
+int LCBUrlFilter::matchPath(const LCBUrl &url) const // Rule of the longest prefix of the path of url, -1 if none
 {
-    if (stripscheme.isEmpty())
+    if (!url.parts.valid)
+        return -1;
+    int retVal = nodes[FILTER_PATH_ROOT].rule;
+    uint32_t node = FILTER_PATH_ROOT;
+    LCBUrlView segment;
+    while (url.nextSegment(segment))
     {
-        stripscheme = "";
-        String tempUrl = getCleanTriplets();
-        int length = getCleanTriplets().length();
-        int slength = getScheme().length();
-        // Remove scheme and ://
-        if ((slength > 0) && (length > slength + 3))
-        {
-            tempUrl = tempUrl.substring(slength); // Remove scheme;
-            for (int i = 0; i <= 3; i++)
-            { // Remove "://" discriminately
-                if (
-                    (isAlphaNumeric(tempUrl.charAt(i))) ||
-                    (tempUrl.charAt(i) == '-') ||
-                    (tempUrl.charAt(i) == '.') ||
-                    (tempUrl.charAt(i) == '_') ||
-                    (tempUrl.charAt(i) == '~'))
-                {
-                    tempUrl = tempUrl.substring(i);
-                    stripscheme = tempUrl;
-                }
-            }
-        }
+        size_t index = 0;
+        node = findChild(node, segment, index);
+        if (node == 0)
+            break;
+        if (nodes[node].rule >= 0)
+            retVal = nodes[node].rule;
     }
-    return stripscheme;
+    return retVal;
 }
 
-String LCBUrl::getRawAuthority() // Authority is similar to "lbussy@raspberrypi.local:80"
+bool LCBUrlFilter::containsUrl(const LCBUrl &url) const // True if url, once normalized, was added with addUrl()
 {
-    if (rawauthority.isEmpty())
+    if (!url.parts.valid || urls.empty())
+        return false;
+    String normal = url.getUrl();
+    if (!bloom.empty())
     {
-        rawauthority = "";
-        String tempUrl = getStripScheme();
-        if (tempUrl && !tempUrl.isEmpty())
+        uint64_t value = hash(normal.c_str(), normal.length());
+        for (uint8_t i = 0; i < LCBURL_BLOOM_HASHES; i++)
         {
-            int loc = tempUrl.indexOf(F("/"), 0);
-            if (loc > 0)
-            {
-                rawauthority = tempUrl.substring(0, loc);
-            }
-            else
-            {
-                rawauthority = tempUrl;
-            }
+            size_t bit = bloomBit(value, i);
+            if ((bloom[bit / 8] & (1 << (bit % 8))) == 0)
+                return false;
         }
     }
-    return rawauthority;
+    size_t index = 0;
+    return findUrl(normal.c_str(), index);
 }
 
-String LCBUrl::getDotSegmentsClear()
+uint32_t LCBUrlFilter::findChild(uint32_t node, const LCBUrlView &text, size_t &index) const // Binary search of the children of node
 {
-    // TODO:  https://tools.ietf.org/html/rfc3986#section-5.2.4
-    return "TODO";
+    return findSorted(nodes[node].children, text, index, [this](uint32_t child) {
+        LCBUrlView retVal;
+        retVal.str = &pool[nodes[child].text];
+        retVal.len = nodes[child].len;
+        return retVal;
+    });
 }
 
-String LCBUrl::getAfterAuth() // Get anything after the authority
+uint32_t LCBUrlFilter::addChild(uint32_t node, const LCBUrlView &text) // Child of node for text, added if missing
 {
-    if (afterauth.isEmpty())
-    {
-        afterauth = "";
-        String tempUrl = getStripScheme();
-        unsigned int length = getRawAuthority().length();
-
-        if (tempUrl.length() > length + 1)
-        {
-            tempUrl.remove(length + 1); // Remove authority
-            afterauth = tempUrl;
-        }
-    }
-    return afterauth;
+    size_t index = 0;
+    uint32_t child = findChild(node, text, index);
+    if (child != 0)
+        return child;
+    child = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+    nodes[child].text = (uint32_t)pool.size();
+    nodes[child].len = text.len;
+    pool.insert(pool.end(), text.str, text.str + text.len);
+    nodes[node].children.insert(nodes[node].children.begin() + index, child);
+    return child;
 }
 
-String LCBUrl::getCleanTriplets() // Convert URL encoded triplets
+bool LCBUrlFilter::findUrl(const char *url, size_t &index) const // Binary search of the exact URLs
 {
-    workingurl = rawurl;
-    unsigned int i = workingurl.length();
-    while (i != 0)
-    {
-        int loc = workingurl.lastIndexOf(F("%"), i);
-        if (loc != -1)
-        {
-            String triplet = rawurl.substring(loc + 1, loc + 3);
-            triplet.toUpperCase();
-            const char *hex = triplet.c_str();
-
-            // Convert hex string to a character
-            int x;
-            char *endptr;
-            x = strtol(hex, &endptr, 16);
-            char character = char(x);
-
-            // Check for characters which should be decoded
-            if (
-                (isAlphaNumeric(character)) ||
-                (character == '-') ||
-                (character == '.') ||
-                (character == '_') ||
-                (character == '~'))
-            {
-                String before = workingurl.substring(0, loc);
-                String after = workingurl.substring(loc + 3);
-                workingurl = before + character + after;
-            }
-            i--;
-        }
-        else
+    size_t low = 0;
+    size_t high = urls.size();
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        int order = strcmp(urls[middle].c_str(), url);
+        if (order == 0)
         {
-            i = 0;
+            index = middle;
+            return true;
         }
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
     }
-    return workingurl;
+    index = low;
+    return false;
 }
 
-String LCBUrl::getPathSegment() // Path will be between the / after host and ?
+size_t LCBUrlFilter::bloomBit(uint64_t value, uint8_t i) const // Bit i of the Bloom filter for a hash, by double hashing
 {
-    if (pathsegment.isEmpty())
-    {
-        String tempUrl = getStripScheme();
-
-        int startloc = tempUrl.indexOf(F("/"));
-        if (startloc > 0)
-        {
-            tempUrl = tempUrl.substring(startloc + 1);
-        }
-        else
-        {
-            tempUrl = "";
-        }
-
-        int endloc = tempUrl.lastIndexOf(F("?"));
-        if (endloc != -1)
-        {
-            tempUrl = tempUrl.substring(0, endloc);
-        }
-        else
-        {
-            int endloc = tempUrl.lastIndexOf(F("#"));
-            if (endloc != -1)
-            {
-                tempUrl = tempUrl.substring(0, endloc - 1);
-            }
-        }
-        pathsegment = tempUrl;
-    }
-    // TODO: Remove dot segments per 5.2.4
-    return pathsegment;
+    uint32_t first = (uint32_t)value;
+    uint32_t second = (uint32_t)(value >> 32) | 1;
+    return (size_t)(first + i * second) % (bloom.size() * 8);
 }
 
-String LCBUrl::getAfterPath() // Get anything after the path
+uint64_t LCBUrlFilter::hash(const char *str, size_t len) // 64-bit FNV-1a
 {
-    if (afterpath.isEmpty())
+    uint64_t retVal = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
     {
-        afterpath = "";
-        String tempUrl = getStripScheme();
-        int queryloc = tempUrl.lastIndexOf(F("?"));
-        if (queryloc != -1)
-        {
-            afterpath = tempUrl.substring(queryloc);
-        }
-        else
-        {
-            int queryloc = tempUrl.lastIndexOf(F("#"));
-            if (queryloc != -1)
-            {
-                afterpath = tempUrl.substring(queryloc);
-            }
-        }
+        retVal ^= (uint8_t)str[i];
+        retVal *= 1099511628211ULL;
     }
-    return afterpath;
+    return retVal;
 }
 
-String LCBUrl::getAfterPathNoFile() // Get anything after the proper RFC-defined path
+// LCBUrlStatic Methods ///////////////////////////////////////////////////////
+// Read-only access to a URL parsed at compile time
+
+LCBUrlStatic LCBUrlStatic::read_P(const LCBUrlStatic *entry) // Copy an entry held in PROGMEM to RAM
 {
-    if (afternofilepath.isEmpty())
-    {
-        afternofilepath = "";
-        String tempUrl = getStripScheme();
-        int queryloc = tempUrl.lastIndexOf(F("/"));
-        if (queryloc != -1)
-        {
-            afternofilepath = tempUrl.substring(queryloc + 1);
-        }
-        else
-        {
-            int queryloc = tempUrl.lastIndexOf(F("?"));
-            if (queryloc != -1)
-            {
-                afternofilepath = tempUrl.substring(queryloc);
-            }
-            else
-            {
-                int queryloc = tempUrl.lastIndexOf(F("#"));
-                if (queryloc != -1)
-                {
-                    afternofilepath = tempUrl.substring(queryloc);
-                }
-            }
-        }
-    }
-    return afternofilepath;
+    LCBUrlStatic retVal;
+    memcpy_P(&retVal, entry, sizeof(LCBUrlStatic));
+    return retVal;
 }
 
-String LCBUrl::getPathSegmentNoFile() // Path will be between the / after host and ?
+String LCBUrlStatic::getPath() const // Path without the leading "/", as getPath() in LCBUrl
 {
-    if (nofilepathsegment.isEmpty())
+    LCBUrlSpan span = parts.path;
+    char first = (span.len > 0) ? (progmem ? (char)pgm_read_byte(str + span.pos) : str[span.pos]) : '\0';
+    if (first == '/')
     {
-        String tempUrl = getStripScheme();
-
-        int startloc = tempUrl.indexOf(F("/"));
-        if (startloc > 0)
-        {
-            tempUrl = tempUrl.substring(startloc + 1);
-        }
-        else
-        {
-            tempUrl = "";
-        }
-
-        int endloc = tempUrl.lastIndexOf(F("/"));
-        if (endloc != -1)
-        {
-            tempUrl = tempUrl.substring(0, endloc + 1);
-        }
-        else
-        {
-            int endloc = tempUrl.lastIndexOf(F("#"));
-            if (endloc != -1)
-            {
-                tempUrl = tempUrl.substring(0, endloc - 1);
-            }
-        }
-        nofilepathsegment = tempUrl;
+        span.pos++;
+        span.len--;
     }
-    // TODO: Remove dot segments per 5.2.4
-    return nofilepathsegment;
+    return getSpan(span);
 }
 
-void LCBUrl::initRegisters() // Clear out the internals to allow the object to be re-used
+String LCBUrlStatic::getSpan(const LCBUrlSpan &span) const
 {
-    rawurl = "";
-    url = "";
-    ipurl = "";
-    workingurl = "";
-    scheme = "";
-    stripscheme = "";
-    rawauthority = "";
-    afterauth = "";
-    userinfo = "";
-    username = "";
-    password = "";
-    host = "";
-    ipaddress = IPADDR_NONE;
-    port = 0;
-    authority = "";
-    ipauthority = "";
-    pathsegment = "";
-    nofilepathsegment = "";
-    path = "";
-    afterpath = "";
-    afternofilepath = "";
-    filename = "";
-    query = "";
-    fragment = "";
+    String retVal = "";
+    retVal.reserve(span.len);
+    for (uint16_t i = 0; i < span.len; i++)
+    {
+        retVal.concat(progmem ? (char)pgm_read_byte(str + span.pos + i) : str[span.pos + i]);
+    }
+    return retVal;
 }
 
 // Utility Methods //////////////////////////////////////////////////////////////
@@ -712,6 +1693,9 @@ bool LCBUrl::isMDNS(const char *fqdn) // Determine if FQDN is mDNS
 
 IPAddress LCBUrl::getIP() // (deprecated) Return IP address of FQDN (helpful for mDNS)
 {
+    // Literal found by setUrl(), no lookup needed
+    if (parts.hosttype == LCBURL_HOST_IPV4)
+        return IPAddress(parts.address[0], parts.address[1], parts.address[2], parts.address[3]);
     return getIP(getHost().c_str());
 }
 
@@ -723,6 +1707,19 @@ IPAddress LCBUrl::getIP(String fqdn) // Return IP address of FQDN (helpful for m
 IPAddress LCBUrl::getIP(const char *fqdn) // Return IP address of FQDN (helpful for mDNS)
 {
     IPAddress returnIP = IPADDR_NONE;
+    // IP literals need no lookup
+    uint8_t address[16] = {};
+    if (LCBUrlIPv4Parser::parse(fqdn, strlen(fqdn), address))
+        return IPAddress(address[0], address[1], address[2], address[3]);
+    if (strchr(fqdn, ':') != NULL && LCBUrlIPv6Parser::parse(fqdn, strcspn(fqdn, "%"), address))
+    {
+        // Without IPv6 support in the core there is nothing to return
+#ifdef LCBURL_IPV6
+        returnIP = IPAddress(IPv6, address);
+#endif
+        return returnIP;
+    }
+
     // First try to resolve the address fresh
     if (isMDNS(fqdn))
     { // Host is an mDNS name
@@ -784,9 +1781,25 @@ IPAddress LCBUrl::getIP(const char *fqdn) // Return IP address of FQDN (helpful
 
 bool LCBUrl::isValidIP(const char *address)
 {
-    // Check if address is a valid IP address
-    IPAddress tempAddress;
-    tempAddress.fromString(address);
+    // Check if address is a valid IPv6 address (other than :: and ::1)
+    if (strchr(address, ':') != NULL)
+    {
+        uint8_t bytes[16] = {};
+        if (!LCBUrlIPv6Parser::parse(address, strcspn(address, "%"), bytes))
+            return false;
+        for (uint8_t i = 0; i < 15; i++)
+        {
+            if (bytes[i] != 0)
+                return true;
+        }
+        return bytes[15] > 1;
+    }
+
+    // Check if address is a valid IPv4 address
+    uint8_t bytes[4] = {};
+    if (!LCBUrlIPv4Parser::parse(address, strlen(address), bytes))
+        return false;
+    IPAddress tempAddress(bytes[0], bytes[1], bytes[2], bytes[3]);
     if (tempAddress == (IPAddress)IPADDR_NONE || tempAddress == (IPAddress)IPADDR_LOOPBACK || tempAddress == (IPAddress)IPADDR_ANY)
         return false;
     else
@@ -796,15 +1809,11 @@ bool LCBUrl::isValidIP(const char *address)
 int LCBUrl::labelCount(const char *fqdn)
 {
     // Return count of labels in a fqdn
-    char *label;
     int labelCount = 0;
-    std::string tempFqdn = std::string(fqdn);
-    label = strtok((char *)tempFqdn.c_str(), ".");
-    while (label != NULL)
-    {
+    size_t len = strlen(fqdn);
+    LCBUrlView label;
+    while (previousLabel(fqdn, len, label))
         labelCount++;
-        label = strtok(NULL, ".");
-    }
     return labelCount;
 }
 
@@ -848,6 +1857,16 @@ bool LCBUrl::isValidHostName(const char *fqdn)
 {
     // This will generally follow RFC1123 and RFC1034
 
+    // Internationalized names are checked in their A-label form
+    for (const char *c = fqdn; *c != '\0'; c++)
+    {
+        if ((uint8_t)*c >= 0x80)
+        {
+            String asciiFqdn = idnaToASCII(fqdn);
+            return !asciiFqdn.isEmpty() && isValidHostName(asciiFqdn.c_str());
+        }
+    }
+
     // Check for min/max length (remember root label and octet count)
     if (strlen(fqdn) < 1 || strlen(fqdn) > 253)
         return false;
@@ -874,3 +1893,176 @@ bool LCBUrl::isValidHostName(const char *fqdn)
 
     return true;
 }
+
+String LCBUrl::idnaToASCII(const char *fqdn)
+{
+    // Map each label per UTS #46 and encode any non-ASCII label as an
+    // A-label ("xn--" + Punycode).  Returns an empty string on failure.
+    String retVal = "";
+    uint32_t label[LABEL_MAX];
+    size_t count = 0;
+    bool ascii = true;
+    size_t len = strlen(fqdn);
+    size_t index = 0;
+    uint8_t triplet = 0; // Hex digits of a "%XY" still to come
+    while (true)
+    {
+        // The last label ends at the end of the name, not at a '.'
+        uint32_t codepoint = '.';
+        bool last = (index >= len);
+        if (!last)
+        {
+            codepoint = decodeUTF8(fqdn, len, index);
+            if (codepoint == UINT32_MAX)
+                return "";
+            if (triplet > 0)
+            {
+                // Triplets keep uppercase hex digits, as in setUrl()
+                triplet--;
+                if (codepoint >= 0x80 || !LCBUrlTokenizer::isHexChar((char)codepoint))
+                    return "";
+                codepoint = (uint32_t)LCBUrlTokenizer::toUpperChar((char)codepoint);
+            }
+            else if (codepoint == '%')
+                triplet = 2;
+            else
+            {
+                codepoint = mapCodePoint(codepoint);
+                if (codepoint == 0)
+                    continue;
+
+                // STD3 rules: a mapped name holds no other ASCII, so a
+                // fullwidth '@', '/' or ':' cannot become a delimiter
+                char c = (char)codepoint;
+                if (codepoint < 0x80 && c != '.' && c != '-' && !LCBUrlTokenizer::isAlphaChar(c) && !LCBUrlTokenizer::isDigitChar(c))
+                    return "";
+            }
+        }
+        else if (triplet > 0)
+            return ""; // A triplet cut short
+        if (codepoint == '.')
+        {
+            // End of a label
+            if (count == 0 && index < len)
+                return "";
+            if (ascii)
+            {
+                for (size_t i = 0; i < count; i++)
+                    retVal.concat((char)label[i]);
+            }
+            else
+            {
+                // A U-label may not start or end with a hyphen either
+                if (label[0] == '-' || label[count - 1] == '-')
+                    return "";
+                unsigned int start = retVal.length();
+                retVal.concat(F("xn--"));
+                if (!punycodeEncode(label, count, retVal) || retVal.length() - start > LABEL_MAX)
+                    return "";
+            }
+            if (last)
+                break;
+            retVal.concat('.');
+            count = 0;
+            ascii = true;
+            continue;
+        }
+        if (count >= LABEL_MAX)
+            return "";
+        if (codepoint >= 0x80)
+            ascii = false;
+        label[count++] = codepoint;
+    }
+    return retVal;
+}
+
+String LCBUrl::idnaToUnicode(const char *fqdn)
+{
+    // Decode each A-label ("xn--") to UTF-8, other labels are kept as they
+    // are.  Returns an empty string on failure.
+    String retVal = "";
+    uint32_t label[LABEL_MAX];
+    size_t len = strlen(fqdn);
+    size_t start = 0;
+    while (start <= len)
+    {
+        size_t end = start;
+        while (end < len && fqdn[end] != '.')
+            end++;
+        if (end - start > 4 && strncasecmp(fqdn + start, "xn--", 4) == 0)
+        {
+            size_t count = 0;
+            if (!punycodeDecode(fqdn + start + 4, end - start - 4, label, count))
+                return "";
+            for (size_t i = 0; i < count; i++)
+                appendUTF8(retVal, label[i]);
+        }
+        else
+        {
+            for (size_t i = start; i < end; i++)
+                retVal.concat(fqdn[i]);
+        }
+        if (end < len)
+            retVal.concat('.');
+        start = end + 1;
+    }
+    return retVal;
+}
+
+size_t LCBUrl::encodedLength(const char *str, uint8_t component)
+{
+    // Length of str once percent-encoded for component
+    size_t length = 0;
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        length += ENCODE_KEEP(*c, component) ? 1 : 3;
+    }
+    return length;
+}
+
+size_t LCBUrl::percentEncode(char *buffer, size_t size, const char *str, uint8_t component)
+{
+    // Percent-encode str for component into buffer.  Returns the encoded
+    // length; nothing is written unless buffer holds that plus a '\0'.
+    static const char hex[] = "0123456789ABCDEF";
+    size_t length = encodedLength(str, component);
+    if (buffer == NULL || length >= size)
+        return length;
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (ENCODE_KEEP(*c, component))
+        {
+            *buffer++ = *c;
+        }
+        else
+        {
+            *buffer++ = '%';
+            *buffer++ = hex[(uint8_t)*c >> 4];
+            *buffer++ = hex[(uint8_t)*c & 0x0F];
+        }
+    }
+    *buffer = '\0';
+    return length;
+}
+
+String LCBUrl::percentEncode(const char *str, uint8_t component)
+{
+    String retVal = "";
+    retVal.reserve(encodedLength(str, component));
+    appendEncoded(retVal, str, component);
+    return retVal;
+}
+
+void LCBUrl::addQueryParam(String &query, const char *key, const char *value)
+{
+    // Append "key=value" (after a "&" if query is not empty), growing the
+    // string once
+    size_t keyLength = encodedLength(key, LCBURL_ENCODE_QUERY_KEY);
+    size_t valueLength = encodedLength(value, LCBURL_ENCODE_QUERY_VALUE);
+    query.reserve(query.length() + keyLength + valueLength + 2);
+    if (!query.isEmpty())
+        query.concat('&');
+    appendEncoded(query, key, LCBURL_ENCODE_QUERY_KEY);
+    query.concat('=');
+    appendEncoded(query, value, LCBURL_ENCODE_QUERY_VALUE);
+}
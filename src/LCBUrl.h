@@ -49,6 +49,60 @@
 #include <string.h>
 #include <Arduino.h>
 #include <iostream>
+#include <vector>
+#include "LCBUrlTokenizer.h"
+
+// IPAddress holds IPv6 addresses in Arduino-ESP32 3.x
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR)
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+#define LCBURL_IPV6
+#endif
+#endif
+
+// Components for percentEncode(), each with its own set of characters
+// which are left as they are
+#define LCBURL_ENCODE_PATH 0x01        // Path, "/" kept
+#define LCBURL_ENCODE_QUERY_KEY 0x02   // Query key, "&", "=" and "+" encoded
+#define LCBURL_ENCODE_QUERY_VALUE 0x04 // Query value, "&" and "+" encoded
+#define LCBURL_ENCODE_USERINFO 0x08    // User name or password, ":" and "@" encoded
+#define LCBURL_ENCODE_FRAGMENT 0x10
+
+// Longest URL accepted by setUrl() and LCBUrlParser, longer input is
+// refused before any work is done.  May be set at build time, up to 65535.
+#ifndef LCBURL_MAX_LENGTH
+#define LCBURL_MAX_LENGTH 2048
+#endif
+#if LCBURL_MAX_LENGTH > 65535
+#error "LCBURL_MAX_LENGTH must not be over 65535"
+#endif
+
+// Path segments LCBUrlRouter matches one by one; the rest of a deeper path
+// can only be taken by a "*name"
+#ifndef LCBURL_ROUTE_DEPTH
+#define LCBURL_ROUTE_DEPTH 16
+#endif
+
+// Hashes set per URL in the Bloom filter of LCBUrlFilter
+#ifndef LCBURL_BLOOM_HASHES
+#define LCBURL_BLOOM_HASHES 3
+#endif
+
+// A piece of a parsed URL, pointing into the object which produced it and
+// valid until that object is changed.  Not terminated.
+struct LCBUrlView
+{
+    const char *str = nullptr;
+    uint16_t len = 0;
+    bool equals(const char *text) const;
+    String toString() const;
+};
+
+// One value captured by LCBUrlRouter; name points into the route pattern
+struct LCBUrlParam
+{
+    LCBUrlView name;
+    LCBUrlView value;
+};
 
 // Library interface description
 class LCBUrl
@@ -58,21 +112,28 @@ public:
     LCBUrl(const String &newUrl = "");
     ~LCBUrl(){};
     bool setUrl(const String &newUrl);
-    String getUrl();
+    bool setUrl(const __FlashStringHelper *newUrl);
+    String getUrl() const;
     String getIPUrl();
-    String getScheme();
-    String getUserInfo();
-    String getUserName();
-    String getPassword();
-    String getHost();
-    unsigned int getPort();
-    String getAuthority();
+    String getScheme() const;
+    String getUserInfo() const;
+    String getUserName() const;
+    String getPassword() const;
+    String getHost() const;
+    String getUnicodeHost() const;
+    unsigned int getPort() const;
+    String getAuthority() const;
     String getIPAuthority();
-    String getPath();
-    String getAfterPath();
-    String getFileName();
-    String getQuery();
-    String getFragment();
+    String getPath() const;
+    String getAfterPath() const;
+    String getFileName() const;
+    String getQuery() const;
+    String getFragment() const;
+    uint8_t getError() const;
+    uint16_t getErrorPosition() const;
+    uint8_t getErrorComponent() const;
+    const __FlashStringHelper *getErrorString() const;
+    bool nextSegment(LCBUrlView &segment) const;
 
     // Utility functions
     bool isMDNS() __attribute__((deprecated));
@@ -85,45 +146,218 @@ public:
     bool isANumber(const char *str);
     bool isValidLabel(const char *label);
     bool isValidHostName(const char *fqdn);
+    String idnaToASCII(const char *fqdn);
+    String idnaToUnicode(const char *fqdn);
+    size_t encodedLength(const char *str, uint8_t component);
+    size_t percentEncode(char *buffer, size_t size, const char *str, uint8_t component);
+    String percentEncode(const char *str, uint8_t component);
+    void addQueryParam(String &query, const char *key, const char *value);
 
     // Library-accessible "private" interface
 private:
+    friend class LCBUrlParser;
+    friend class LCBUrlFilter;
     bool hasEnding(std::string const &fullString, std::string const &ending);
-    String getUrl(bool ipaddr, String &url_string);
+    void appendUrl(String &url_string, const String &authority_string) const;
     String getCleanTriplets();
     String getDotSegmentsClear();
-    String getStripScheme();
-    String getRawAuthority();
-    String getAuthority(bool ipaddr, String &authority_string);
-    String getAfterAuth();
-    String getPathSegment();
-    String getPathSegmentNoFile();
-    String getAfterPathNoFile();
+    void appendAuthority(String &authority_string, const String &host) const;
+    String getSpan(const LCBUrlSpan &span) const;
+    uint16_t getRawPosition(uint16_t position);
+#ifdef LCBURL_DEBUG_CHECKS
+    void checkParts();
+#endif
+    bool setParts(const LCBUrlParts &newParts);
+    char decodeTriplet(char hi, char lo);
+    uint32_t decodeUTF8(const char *str, size_t len, size_t &index);
+    void appendUTF8(String &output, uint32_t codepoint);
+    uint32_t mapCodePoint(uint32_t codepoint);
+    bool punycodeEncode(const uint32_t *input, size_t length, String &output);
+    bool punycodeDecode(const char *input, size_t length, uint32_t *output, size_t &count);
+    void appendEncoded(String &output, const char *str, uint8_t component);
     void initRegisters();
     String rawurl = "";
-    String url = "";
-    String ipurl = "";
     String workingurl = "";
-    String scheme = "";
-    String stripscheme = "";
-    String rawauthority = "";
-    String afterauth = "";
-    String userinfo = "";
-    String username = "";
-    String password = "";
-    String host = "";
+    LCBUrlParts parts;
+    String asciihost = "";   // A-label form of an internationalized host
+    String unicodehost = ""; // U-label form of a host with A-labels
+    String ipurl = "";       // Filled by the first getIPUrl(), after a lookup
     IPAddress ipaddress = INADDR_NONE;
-    unsigned int port = 0;
-    String authority = "";
-    String ipauthority = "";
-    String pathsegment = "";
-    String nofilepathsegment = "";
-    String path = "";
-    String afterpath = "";
-    String afternofilepath = "";
-    String filename = "";
-    String query = "";
-    String fragment = "";
+    String ipauthority = ""; // Filled by the first getIPAuthority()
+};
+
+// Incremental (push) parser for a URL which arrives in pieces, such as a
+// request line read from a socket.  Bytes are decoded and tokenized as they
+// arrive and written straight into the target LCBUrl; no copy of the whole
+// URL is assembled first.
+class LCBUrlParser
+{
+    // User-accessible "public" interface
+public:
+    LCBUrlParser(LCBUrl &target);
+    ~LCBUrlParser(){};
+    void begin(size_t expected = 0);
+    bool push(char c);
+    bool push(const char *data, size_t len);
+    bool finish();
+
+    // Library-accessible "private" interface
+private:
+    bool emit(char *chunk, size_t &used, char c);
+    void reject(const LCBUrlParts &error);
+    uint16_t getRawPosition(uint16_t position) const;
+    LCBUrl &url;
+    LCBUrlTokenizer tokenizer;
+    char triplet[3] = {};
+    uint8_t pending = 0;           // Bytes of a "%XY" triplet held in triplet[]
+    std::vector<uint16_t> decodes; // Target offsets of decoded triplets
+    size_t reserved = 0;
+    bool failed = false;
+};
+
+// Route table for dispatching on the path of a parsed URL.  Patterns are
+// split into segments and kept as a trie, so a URL is matched in time
+// proportional to its depth rather than to the number of routes.  A
+// segment may be literal text, ":name" (any one segment, captured) or
+// "*name" (the rest of the path, captured; last segment only).  Literal
+// segments win over ":name", which wins over "*name".  Patterns are kept by
+// pointer and must outlive the router.
+class LCBUrlRouter
+{
+    // User-accessible "public" interface
+public:
+    LCBUrlRouter();
+    ~LCBUrlRouter(){};
+    bool addRoute(const char *pattern, int route);
+    int match(const LCBUrl &url) const;
+    int match(const LCBUrl &url, LCBUrlParam *params, uint8_t size, uint8_t &count) const;
+
+    // Library-accessible "private" interface
+private:
+    struct Node
+    {
+        LCBUrlView text;                // Literal text, or the capture name
+        int route = -1;                 // Route which ends here, -1 if none
+        uint16_t param = 0;             // ":name" child, 0 if none
+        uint16_t wildcard = 0;          // "*name" child, 0 if none
+        std::vector<uint16_t> children; // Literal children, sorted by text
+    };
+    struct Path
+    {
+        LCBUrlView segments[LCBURL_ROUTE_DEPTH];
+        uint8_t count = 0;
+        const char *rest = nullptr; // First segment past segments[], if any
+        const char *end = nullptr;  // End of the last segment
+    };
+    uint16_t findChild(const Node &node, const LCBUrlView &segment, size_t &index) const;
+    int matchNode(uint16_t node, const Path &path, uint8_t depth, LCBUrlParam *params, uint8_t size, uint8_t &found) const;
+    std::vector<Node> nodes;
+};
+
+// Allow/deny list matcher for parsed URLs.  Host suffixes are kept as a
+// trie of labels read right to left and path prefixes as a trie of
+// segments, so a URL is checked in time proportional to the number of its
+// labels and segments rather than to the number of rules.  The longest
+// matching suffix or prefix wins.  Exact URLs are kept sorted, optionally
+// behind a Bloom filter so most misses cost one hash.  Rules are
+// normalized as setUrl() would normalize them, and copied, so they need
+// not outlive the filter.
+class LCBUrlFilter
+{
+    // User-accessible "public" interface
+public:
+    LCBUrlFilter(size_t bloombits = 0);
+    ~LCBUrlFilter(){};
+    bool addHost(const char *suffix, int rule);
+    bool addPath(const char *prefix, int rule);
+    bool addUrl(const char *url);
+    int matchHost(const LCBUrl &url) const;
+    int matchPath(const LCBUrl &url) const;
+    bool containsUrl(const LCBUrl &url) const;
+
+    // Library-accessible "private" interface
+private:
+    struct Node
+    {
+        uint32_t text = 0;              // Offset of the label or segment in pool
+        uint16_t len = 0;               // Length of the label or segment
+        int rule = -1;                  // Rule which ends here, -1 if none
+        std::vector<uint32_t> children; // Sorted by text
+    };
+    uint32_t findChild(uint32_t node, const LCBUrlView &text, size_t &index) const;
+    uint32_t addChild(uint32_t node, const LCBUrlView &text);
+    bool findUrl(const char *url, size_t &index) const;
+    size_t bloomBit(uint64_t value, uint8_t i) const;
+    static uint64_t hash(const char *str, size_t len);
+    std::vector<Node> nodes;
+    std::vector<char> pool;     // Text of every node, not terminated
+    std::vector<String> urls;   // Normalized exact URLs, sorted
+    std::vector<uint8_t> bloom; // Empty unless bloombits was given
 };
 
+// A fixed URL, split once by the compiler and held in read-only storage.
+// Components are returned exactly as written in the literal (no
+// normalization is done).  With progmem set the literal is in PROGMEM; an
+// LCBUrlStatic which is itself in PROGMEM is read back with read_P().
+class LCBUrlStatic
+{
+    // User-accessible "public" interface
+public:
+    template <size_t N>
+    LCBURL_CONSTEXPR LCBUrlStatic(const char (&literal)[N], bool progmem = false) : str(literal), parts(LCBUrlTokenizer::parse(literal, N - 1)), progmem(progmem) {}
+    static LCBUrlStatic read_P(const LCBUrlStatic *entry);
+    LCBURL_CONSTEXPR bool isValid() const { return parts.valid; }
+    LCBURL_CONSTEXPR bool isProgmem() const { return progmem; }
+    LCBURL_CONSTEXPR uint8_t getError() const { return parts.error; }
+    LCBURL_CONSTEXPR const char *c_str() const { return str; }
+    LCBURL_CONSTEXPR const LCBUrlParts &getParts() const { return parts; }
+    LCBURL_CONSTEXPR unsigned int getPort() const;
+    String getUrl() const { return progmem ? String(FPSTR(str)) : String(str); }
+    String getScheme() const { return getSpan(parts.scheme); }
+    String getUserInfo() const { return getSpan(parts.userinfo); }
+    String getUserName() const { return getSpan(parts.username); }
+    String getPassword() const { return getSpan(parts.password); }
+    String getHost() const { return getSpan(parts.host); }
+    String getPath() const;
+    String getQuery() const { return getSpan(parts.query); }
+    String getFragment() const { return getSpan(parts.fragment); }
+
+    // Library-accessible "private" interface
+private:
+    LCBUrlStatic() : str(""), parts(), progmem(false) {}
+    String getSpan(const LCBUrlSpan &span) const;
+    const char *str;
+    LCBUrlParts parts;
+    bool progmem;
+};
+
+LCBURL_CONSTEXPR unsigned int LCBUrlStatic::getPort() const // Explicit port, or the default for the scheme
+{
+    return (parts.port.len != 0) ? parts.portnum : parts.defaultport;
+}
+
+// Declare a URL literal which is parsed by the compiler.  A malformed URL
+// fails the build.  Without C++14 the URL is parsed during startup instead.
+#ifdef LCBURL_HAS_CONSTEXPR
+#define LCBURL_STATIC(name, literal)        \
+    constexpr LCBUrlStatic name(literal); \
+    static_assert(name.isValid(), "LCBUrl: malformed URL " literal)
+#else
+#define LCBURL_STATIC(name, literal) const LCBUrlStatic name(literal)
+#endif
+
+// As LCBURL_STATIC(), with the literal and the component table both in
+// PROGMEM.  Use LCBUrlStatic::read_P(&name) to get a copy in RAM.
+#ifdef LCBURL_HAS_CONSTEXPR
+#define LCBURL_STATIC_P(name, literal)                   \
+    static constexpr char name##_P[] PROGMEM = literal; \
+    constexpr LCBUrlStatic name PROGMEM = LCBUrlStatic(name##_P, true); \
+    static_assert(name.isValid(), "LCBUrl: malformed URL " literal)
+#else
+// The table is built during startup, so only the literal can be in flash
+#define LCBURL_STATIC_P(name, literal)                   \
+    static const char name##_P[] PROGMEM = literal;     \
+    const LCBUrlStatic name = LCBUrlStatic(name##_P, true)
+#endif
+
 #endif // _LCBURL_H
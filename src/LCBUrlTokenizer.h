@@ -0,0 +1,975 @@
+/*
+    LCBUrlTokenizer.h - Single-pass URL tokenizer for LCBUrl - Splits a URL
+                        into its RFC3986 components without allocating, and
+                        may be evaluated at compile time.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Ensure this library description is only included once
+
+#ifndef _LCBURL_TOKENIZER_H
+#define _LCBURL_TOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The tokenizer is written as C++14 (relaxed) constexpr so fixed URLs may be
+// parsed by the compiler.  Older toolchains (gnu++11) still get the same
+// code, it simply runs at startup instead.
+#if __cplusplus >= 201402L
+#define LCBURL_HAS_CONSTEXPR
+#define LCBURL_CONSTEXPR constexpr
+#else
+#define LCBURL_CONSTEXPR inline
+#endif
+
+// Offset and length of one component within the URL string
+struct LCBUrlSpan
+{
+    uint16_t pos = 0;
+    uint16_t len = 0;
+};
+
+// Component table produced by the tokenizer
+struct LCBUrlParts
+{
+    LCBUrlSpan scheme;
+    LCBUrlSpan userinfo;
+    LCBUrlSpan username;
+    LCBUrlSpan password;
+    LCBUrlSpan host;
+    LCBUrlSpan port;
+    LCBUrlSpan path; // Includes the leading "/" if present
+    LCBUrlSpan query;
+    LCBUrlSpan fragment;
+    uint16_t portnum = 0;     // Explicit port, given if the port span is not empty
+    uint16_t defaultport = 0; // Default port for the scheme, 0 if unknown
+    uint8_t hosttype = 0;     // LCBURL_HOST_* below
+    uint8_t address[16] = {}; // Network byte order, valid for a literal host
+    bool nonascii = false;    // Host holds UTF-8 (internationalized name)
+    bool authority = false;
+    bool valid = false;
+    uint8_t error = 0;          // LCBURL_ERR_* below
+    uint8_t errorcomponent = 0; // LCBURL_COMPONENT_* below
+    uint16_t errorpos = 0;      // Offset of the offending byte
+};
+
+// Why a URL was rejected
+#define LCBURL_ERR_NONE 0
+#define LCBURL_ERR_EMPTY 1              // No URL given
+#define LCBURL_ERR_SCHEME 2             // Missing or malformed scheme
+#define LCBURL_ERR_AUTHORITY_REQUIRED 3 // Scheme requires "//authority"
+#define LCBURL_ERR_CHARACTER 4          // Character not allowed in the component
+#define LCBURL_ERR_PERCENT 5            // '%' not followed by two hex digits
+#define LCBURL_ERR_HOST_EMPTY 6         // Scheme requires a host
+#define LCBURL_ERR_IP_LITERAL 7         // Malformed "[...]" address or zone ID
+#define LCBURL_ERR_LABEL 8              // Empty, overlong (>63) or hyphenated label
+#define LCBURL_ERR_HOST_LENGTH 9        // Host over 253 characters
+#define LCBURL_ERR_PORT 10              // Port is not a number
+#define LCBURL_ERR_PORT_RANGE 11        // Port over 65535
+#define LCBURL_ERR_TOO_LONG 12          // URL over the maximum length
+#define LCBURL_ERR_IDNA 13              // Host cannot be converted to A-labels
+
+// Where in the URL the error was found
+#define LCBURL_COMPONENT_NONE 0
+#define LCBURL_COMPONENT_SCHEME 1
+#define LCBURL_COMPONENT_AUTHORITY 2 // Userinfo or host, not yet known which
+#define LCBURL_COMPONENT_USERINFO 3
+#define LCBURL_COMPONENT_HOST 4
+#define LCBURL_COMPONENT_PORT 5
+#define LCBURL_COMPONENT_PATH 6
+#define LCBURL_COMPONENT_QUERY 7
+#define LCBURL_COMPONENT_FRAGMENT 8
+
+#define LCBURL_HOST_NAME 0
+#define LCBURL_HOST_IPV4 1 // Dotted-decimal literal, address[0..3]
+#define LCBURL_HOST_IPV6 2 // Bracketed literal, the host span excludes the brackets
+
+// Incremental RFC3986 IPv4address (dec-octet "." x4, no leading zeros)
+// conversion.  Runs alongside the host so a literal is known once the
+// authority ends.
+class LCBUrlIPv4Parser
+{
+    // User-accessible "public" interface
+public:
+    LCBURL_CONSTEXPR LCBUrlIPv4Parser() {}
+    LCBURL_CONSTEXPR bool push(char c);
+    LCBURL_CONSTEXPR bool finish(uint8_t *address);
+    LCBURL_CONSTEXPR void reset() { *this = LCBUrlIPv4Parser(); }
+    static LCBURL_CONSTEXPR bool parse(const char *str, size_t len, uint8_t *address);
+
+    // Library-accessible "private" interface
+private:
+    uint8_t octets[4] = {};
+    uint16_t value = 0; // Current octet
+    uint8_t digits = 0; // Digits in current octet
+    uint8_t dots = 0;
+    bool failed = false;
+};
+
+// Incremental RFC4291 (section 2.2) text to address conversion, including
+// the "::" gap and a trailing dotted IPv4 part.  Bytes are pushed one at a
+// time so the tokenizer can run it alongside the authority.
+class LCBUrlIPv6Parser
+{
+    // User-accessible "public" interface
+public:
+    LCBURL_CONSTEXPR LCBUrlIPv6Parser() {}
+    LCBURL_CONSTEXPR bool push(char c);
+    LCBURL_CONSTEXPR bool finish(uint8_t *address);
+    static LCBURL_CONSTEXPR bool parse(const char *str, size_t len, uint8_t *address);
+
+    // Library-accessible "private" interface
+private:
+    LCBURL_CONSTEXPR bool fail();
+    uint16_t words[8] = {};
+    uint8_t count = 0;   // Groups completed
+    int8_t gap = -1;     // Group index of "::", -1 if none
+    uint16_t hex = 0;    // Current group read as hex
+    uint16_t dec = 0;    // Current group read as decimal
+    uint8_t digits = 0;  // Digits in current group
+    bool decimal = true; // Current group has only decimal digits
+    uint8_t octets = 0;  // IPv4 octets completed, after the first '.'
+    uint8_t v4[4] = {};
+    bool colon = false;  // Previous byte was ':'
+    bool lead = false;   // Address began with a single ':'
+    bool failed = false;
+};
+
+// Properties of a known scheme
+struct LCBUrlScheme
+{
+    const char *name;
+    uint16_t port; // Default port, 0 if the scheme has none
+    uint8_t flags;
+};
+
+#define LCBURL_SCHEME_AUTHORITY 0x01 // Requires "//authority"
+#define LCBURL_SCHEME_HOST 0x02      // Requires a non-empty host
+
+// Known schemes, sorted by name.  The lookup hashes into lcburlschemeslots,
+// which holds (index + 1) of the matching entry or 0 for an empty slot.
+constexpr LCBUrlScheme lcburlschemes[] = {
+    {"coap", 5683, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"coaps", 5684, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"file", 0, 0},
+    {"ftp", 21, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"http", 80, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"https", 443, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"ldap", 389, LCBURL_SCHEME_AUTHORITY},
+    {"ldaps", 636, LCBURL_SCHEME_AUTHORITY},
+    {"mailto", 0, 0},
+    {"mqtt", 1883, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"mqtts", 8883, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"rtsp", 554, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"sftp", 22, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"ssh", 22, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"telnet", 23, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"ws", 80, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+    {"wss", 443, LCBURL_SCHEME_AUTHORITY | LCBURL_SCHEME_HOST},
+};
+
+constexpr uint8_t lcburlschemeslots[32] = {
+    0, 0, 0, 0, 5, 9, 0, 0, 7, 0, 17, 0, 3, 0, 12, 13,
+    14, 10, 0, 4, 2, 0, 15, 0, 0, 6, 0, 16, 0, 8, 11, 1};
+
+// Library interface description
+class LCBUrlTokenizer
+{
+    // User-accessible "public" interface
+public:
+    LCBURL_CONSTEXPR LCBUrlTokenizer() {}
+    LCBURL_CONSTEXPR bool push(char c);
+    LCBURL_CONSTEXPR bool finish();
+    LCBURL_CONSTEXPR const LCBUrlParts &getParts() const { return parts; }
+    static LCBURL_CONSTEXPR LCBUrlParts parse(const char *str, size_t len);
+    static LCBURL_CONSTEXPR const LCBUrlScheme *findScheme(const char *name, size_t len);
+    static LCBURL_CONSTEXPR uint8_t checkHostName(const char *host, size_t len);
+
+    static LCBURL_CONSTEXPR bool isAlphaChar(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static LCBURL_CONSTEXPR bool isDigitChar(char c) { return c >= '0' && c <= '9'; }
+    static LCBURL_CONSTEXPR bool isHexChar(char c) { return isDigitChar(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+    static LCBURL_CONSTEXPR bool isUnreservedChar(char c) { return isAlphaChar(c) || isDigitChar(c) || c == '-' || c == '.' || c == '_' || c == '~'; }
+    static LCBURL_CONSTEXPR bool isSubDelimChar(char c);
+    static LCBURL_CONSTEXPR bool isPChar(char c) { return isUnreservedChar(c) || isSubDelimChar(c) || c == ':' || c == '@'; }
+    static LCBURL_CONSTEXPR char toLowerChar(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c; }
+    static LCBURL_CONSTEXPR char toUpperChar(char c) { return (c >= 'a' && c <= 'z') ? (char)(c - ('a' - 'A')) : c; }
+
+    // Library-accessible "private" interface
+private:
+    enum State : uint8_t
+    {
+        SCHEME_START,
+        SCHEME,
+        AFTER_SCHEME,
+        SLASH,
+        AUTHORITY,
+        PATH,
+        QUERY,
+        FRAGMENT,
+        FAILED
+    };
+    static const uint8_t schememax = 8;
+    static const uint8_t labelmax = 63;
+    static const uint8_t hostmax = 253;
+    LCBURL_CONSTEXPR bool fail(uint8_t error);
+    LCBURL_CONSTEXPR bool fail(uint8_t error, uint16_t position, uint8_t component);
+    static LCBURL_CONSTEXPR uint8_t schemeHash(const char *name, size_t len);
+    LCBURL_CONSTEXPR void endScheme();
+    LCBURL_CONSTEXPR uint8_t authorityChar(char c);
+    LCBURL_CONSTEXPR void hostChar(char c);
+    LCBURL_CONSTEXPR bool endAuthority();
+    LCBURL_CONSTEXPR bool startPath(char c);
+    LCBURL_CONSTEXPR bool pathChar(char c);
+    LCBUrlParts parts;
+    State state = SCHEME_START;
+    uint16_t pos = 0;
+    uint8_t pct = 0;                 // Hex digits still expected after a '%'
+    char scheme[schememax + 1] = {}; // Lowercase copy of the scheme
+    uint8_t schemeflags = 0;
+    uint16_t authstart = 0;
+    uint16_t hoststart = 0;
+    uint16_t atloc = 0;      // Last '@' in the authority, 0 if none
+    uint16_t usercolon = 0;  // First ':' in the authority, 0 if none
+    uint16_t portcolon = 0;  // First ':' after the last '@', 0 if none
+    uint16_t portvalue = 0;
+    bool portbad = false;   // Port holds a non-digit or a second ':'
+    bool portrange = false; // Port is over 65535
+    bool nonascii = false;
+    uint8_t labellen = 0;
+    bool labelhyphen = false; // Last byte of the label was '-'
+    uint16_t labelerror = 0;  // First bad label byte in the host, 0 if none
+    uint8_t bracket = 0; // 1 inside "[...]", 2 in a zone ID, 3 after "]"
+    uint8_t zonepct = 0; // Bytes of "%25" still expected
+    uint16_t zonestart = 0;
+    uint16_t hostend = 0;
+    LCBUrlIPv4Parser ipv4;
+    LCBUrlIPv6Parser ipv6;
+};
+
+// Inline implementation - kept in the header so it is usable in constant
+// expressions
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::isSubDelimChar(char c)
+{
+    return c == '!' || c == '$' || c == '&' || c == '\'' || c == '(' || c == ')' ||
+           c == '*' || c == '+' || c == ',' || c == ';' || c == '=';
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv4Parser::push(char c)
+{
+    uint8_t digit = (uint8_t)(c - '0');
+    if (digit < 10)
+    {
+        // A leading zero may only be the whole octet
+        failed |= (digits == 1 && value == 0);
+        value = (uint16_t)(value * 10 + digit);
+        digits++;
+        failed |= (value > 255);
+    }
+    else if (c == '.')
+    {
+        failed |= (digits == 0 || dots == 3);
+        octets[dots & 3] = (uint8_t)value;
+        dots++;
+        value = 0;
+        digits = 0;
+    }
+    else
+        failed = true;
+    return !failed;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv4Parser::finish(uint8_t *address) // Address is 4 bytes
+{
+    if (failed || dots != 3 || digits == 0)
+        return false;
+    octets[3] = (uint8_t)value;
+    for (uint8_t i = 0; i < 4; i++)
+        address[i] = octets[i];
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv4Parser::parse(const char *str, size_t len, uint8_t *address)
+{
+    LCBUrlIPv4Parser parser;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!parser.push(str[i]))
+            return false;
+    }
+    return parser.finish(address);
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv6Parser::fail()
+{
+    failed = true;
+    return false;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv6Parser::push(char c)
+{
+    if (failed)
+        return false;
+    if (LCBUrlTokenizer::isHexChar(c))
+    {
+        if (lead || (octets > 0 && !LCBUrlTokenizer::isDigitChar(c)))
+            return fail();
+        uint8_t value = (uint8_t)(LCBUrlTokenizer::isDigitChar(c) ? c - '0' : (LCBUrlTokenizer::toLowerChar(c) - 'a' + 10));
+        if (++digits > 4)
+            return fail();
+        hex = (uint16_t)(hex * 16 + value);
+        if (value > 9)
+            decimal = false;
+        dec = (uint16_t)(dec * 10 + value);
+        colon = false;
+        return true;
+    }
+    if (c == ':')
+    {
+        if (octets > 0)
+            return fail();
+        if (digits > 0)
+        {
+            if (count >= 8)
+                return fail();
+            words[count++] = hex;
+        }
+        else if (colon)
+        {
+            // Second colon of "::"
+            if (gap >= 0)
+                return fail();
+            gap = (int8_t)count;
+            lead = false;
+        }
+        else if (count == 0)
+            lead = true;
+        else
+            return fail();
+        hex = 0;
+        dec = 0;
+        digits = 0;
+        decimal = true;
+        colon = true;
+        return true;
+    }
+    if (c == '.')
+    {
+        // Dotted IPv4 tail, the current group was an octet; as in
+        // LCBUrlIPv4Parser a leading zero may only be the whole octet
+        if (digits == 0 || digits > 3 || !decimal || dec > 255 || octets >= 3 || count > 6)
+            return fail();
+        if (digits > 1 && dec < (digits == 2 ? 10 : 100))
+            return fail();
+        v4[octets++] = (uint8_t)dec;
+        hex = 0;
+        dec = 0;
+        digits = 0;
+        colon = false;
+        return true;
+    }
+    return fail();
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv6Parser::finish(uint8_t *address) // Address is 16 bytes
+{
+    if (failed || lead)
+        return fail();
+    if (octets > 0)
+    {
+        if (octets != 3 || digits == 0 || digits > 3 || dec > 255 || count > 6)
+            return fail();
+        if (digits > 1 && dec < (digits == 2 ? 10 : 100))
+            return fail();
+        v4[3] = (uint8_t)dec;
+        words[count++] = (uint16_t)((v4[0] << 8) | v4[1]);
+        words[count++] = (uint16_t)((v4[2] << 8) | v4[3]);
+    }
+    else if (digits > 0)
+    {
+        if (count >= 8)
+            return fail();
+        words[count++] = hex;
+    }
+    else if (colon && gap != (int8_t)count)
+        return fail(); // Trailing single ':'
+    else if (!colon)
+        return fail(); // Empty
+
+    if (gap >= 0)
+    {
+        if (count > 7)
+            return fail();
+        // Move the groups after "::" to the end
+        uint8_t tail = (uint8_t)(count - gap);
+        for (uint8_t i = 0; i < tail; i++)
+        {
+            words[7 - i] = words[count - 1 - i];
+            words[count - 1 - i] = 0;
+        }
+    }
+    else if (count != 8)
+        return fail();
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        address[i * 2] = (uint8_t)(words[i] >> 8);
+        address[i * 2 + 1] = (uint8_t)(words[i] & 0xff);
+    }
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlIPv6Parser::parse(const char *str, size_t len, uint8_t *address)
+{
+    LCBUrlIPv6Parser parser;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!parser.push(str[i]))
+            return false;
+    }
+    return parser.finish(address);
+}
+
+LCBURL_CONSTEXPR LCBUrlParts LCBUrlTokenizer::parse(const char *str, size_t len)
+{
+    LCBUrlTokenizer tokenizer;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!tokenizer.push(str[i]))
+            break;
+    }
+    tokenizer.finish();
+    return tokenizer.getParts();
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::fail(uint8_t error) // Fail on the current byte
+{
+    uint8_t component = LCBURL_COMPONENT_NONE;
+    switch (state)
+    {
+    case SCHEME_START:
+    case SCHEME:
+        component = LCBURL_COMPONENT_SCHEME;
+        break;
+    case AFTER_SCHEME:
+    case SLASH:
+        component = (schemeflags & LCBURL_SCHEME_AUTHORITY) ? LCBURL_COMPONENT_AUTHORITY : LCBURL_COMPONENT_PATH;
+        break;
+    case AUTHORITY:
+        if (bracket != 0 || atloc != 0)
+            component = (portcolon != 0) ? LCBURL_COMPONENT_PORT : LCBURL_COMPONENT_HOST;
+        else
+            component = LCBURL_COMPONENT_AUTHORITY;
+        break;
+    case PATH:
+        component = LCBURL_COMPONENT_PATH;
+        break;
+    case QUERY:
+        component = LCBURL_COMPONENT_QUERY;
+        break;
+    case FRAGMENT:
+        component = LCBURL_COMPONENT_FRAGMENT;
+        break;
+    case FAILED:
+        return false;
+    }
+    return fail(error, pos, component);
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::fail(uint8_t error, uint16_t position, uint8_t component)
+{
+    if (state != FAILED)
+    {
+        parts.error = error;
+        parts.errorpos = position;
+        parts.errorcomponent = component;
+    }
+    state = FAILED;
+    parts.valid = false;
+    return false;
+}
+
+LCBURL_CONSTEXPR uint8_t LCBUrlTokenizer::schemeHash(const char *name, size_t len)
+{
+    return (uint8_t)((len * 15 + (uint8_t)name[0] + 2 * (uint8_t)name[len - 1]) & 31);
+}
+
+LCBURL_CONSTEXPR const LCBUrlScheme *LCBUrlTokenizer::findScheme(const char *name, size_t len) // Lowercase name
+{
+    if (len == 0 || len > schememax)
+        return nullptr;
+    uint8_t slot = lcburlschemeslots[schemeHash(name, len)];
+    if (slot == 0)
+        return nullptr;
+    const LCBUrlScheme *entry = &lcburlschemes[slot - 1];
+    for (size_t i = 0; i < len; i++)
+    {
+        if (entry->name[i] != name[i])
+            return nullptr;
+    }
+    return (entry->name[len] == '\0') ? entry : nullptr;
+}
+
+LCBURL_CONSTEXPR uint8_t LCBUrlTokenizer::checkHostName(const char *host, size_t len) // DNS label rules for a whole ASCII host
+{
+    if (len > hostmax)
+        return LCBURL_ERR_HOST_LENGTH;
+    size_t label = 0;
+    for (size_t i = 0; i <= len; i++)
+    {
+        if (i == len || host[i] == '.')
+        {
+            if (i == len && label == 0 && len > 0)
+                break; // Root label
+            if (label == 0 || label > labelmax || host[i - 1] == '-')
+                return LCBURL_ERR_LABEL;
+            label = 0;
+        }
+        else
+        {
+            if (label == 0 && host[i] == '-')
+                return LCBURL_ERR_LABEL;
+            label++;
+        }
+    }
+    return LCBURL_ERR_NONE;
+}
+
+#ifdef LCBURL_HAS_CONSTEXPR
+namespace lcburl_check
+{
+    constexpr bool schemesSorted()
+    {
+        for (size_t i = 1; i < sizeof(lcburlschemes) / sizeof(lcburlschemes[0]); i++)
+        {
+            const char *a = lcburlschemes[i - 1].name;
+            const char *b = lcburlschemes[i].name;
+            while (*a != '\0' && *a == *b)
+            {
+                a++;
+                b++;
+            }
+            if ((uint8_t)*a >= (uint8_t)*b)
+                return false;
+        }
+        return true;
+    }
+
+    constexpr bool schemesHashed()
+    {
+        for (size_t i = 0; i < sizeof(lcburlschemes) / sizeof(lcburlschemes[0]); i++)
+        {
+            size_t len = 0;
+            while (lcburlschemes[i].name[len] != '\0')
+                len++;
+            if (LCBUrlTokenizer::findScheme(lcburlschemes[i].name, len) != &lcburlschemes[i])
+                return false;
+        }
+        return true;
+    }
+} // namespace lcburl_check
+
+static_assert(lcburl_check::schemesSorted(), "LCBUrl: scheme table must be sorted");
+static_assert(lcburl_check::schemesHashed(), "LCBUrl: scheme slot table does not match scheme table");
+#endif
+
+LCBURL_CONSTEXPR void LCBUrlTokenizer::endScheme() // Pick up defaults for a known scheme
+{
+    parts.scheme.len = pos;
+    const LCBUrlScheme *entry = findScheme(scheme, pos);
+    if (entry != nullptr)
+    {
+        parts.defaultport = entry->port;
+        schemeflags = entry->flags;
+    }
+}
+
+LCBURL_CONSTEXPR uint8_t LCBUrlTokenizer::authorityChar(char c) // Handle one byte of "[userinfo@]host[:port]"
+{
+    if (bracket == 1 || bracket == 2)
+    {
+        // IP-literal, with an optional RFC6874 zone ID after "%25"
+        if (c == ']')
+        {
+            if (bracket == 2 && zonestart + 3 == pos)
+                return LCBURL_ERR_IP_LITERAL; // Empty zone ID
+            hostend = pos;
+            if (!ipv6.finish(parts.address))
+                return LCBURL_ERR_IP_LITERAL;
+            parts.hosttype = LCBURL_HOST_IPV6;
+            bracket = 3;
+            return LCBURL_ERR_NONE;
+        }
+        if (bracket == 1 && c == '%')
+        {
+            zonestart = pos;
+            bracket = 2;
+            zonepct = 2;
+            return LCBURL_ERR_NONE;
+        }
+        if (bracket == 2)
+            return (isUnreservedChar(c) || c == '%') ? LCBURL_ERR_NONE : LCBURL_ERR_IP_LITERAL;
+        return ipv6.push(c) ? LCBURL_ERR_NONE : LCBURL_ERR_IP_LITERAL;
+    }
+    if (c == '[')
+    {
+        if (pos != hoststart || bracket != 0)
+            return LCBURL_ERR_CHARACTER;
+        bracket = 1;
+        hoststart = pos + 1;
+        return LCBURL_ERR_NONE;
+    }
+    if (bracket == 3 && (c == '@' || (portcolon == 0 && c != ':')))
+        return LCBURL_ERR_CHARACTER; // Only a port may follow "]"
+    if (c == '@')
+    {
+        // Userinfo runs to the last '@', anything before it is not a port
+        if (nonascii)
+            return LCBURL_ERR_CHARACTER;
+        atloc = pos;
+        hoststart = pos + 1;
+        ipv4.reset();
+        labellen = 0;
+        labelhyphen = false;
+        labelerror = 0;
+        portcolon = 0;
+        portvalue = 0;
+        portbad = false;
+        portrange = false;
+        return LCBURL_ERR_NONE;
+    }
+    if (c == ':')
+    {
+        if (usercolon == 0)
+            usercolon = pos;
+        if (portcolon == 0)
+        {
+            portcolon = pos;
+            portvalue = 0;
+        }
+        else
+            portbad = true;
+        return LCBURL_ERR_NONE;
+    }
+    if ((uint8_t)c >= 0x80 && portcolon == 0)
+        nonascii = true; // UTF-8, converted to an A-label by LCBUrl
+    else if (!isUnreservedChar(c) && !isSubDelimChar(c) && c != '%')
+        return LCBURL_ERR_CHARACTER;
+    if (portcolon == 0)
+        hostChar(c);
+    else
+    {
+        // Accumulate in place, stopping before the value wraps
+        uint8_t digit = (uint8_t)(c - '0');
+        if (digit > 9)
+            portbad = true;
+        else if (portvalue > 6553 || (portvalue == 6553 && digit > 5))
+            portrange = true;
+        else if (!portrange)
+            portvalue = (uint16_t)(portvalue * 10 + digit);
+    }
+    return LCBURL_ERR_NONE;
+}
+
+LCBURL_CONSTEXPR void LCBUrlTokenizer::hostChar(char c) // Track literal and label rules for a reg-name host
+{
+    ipv4.push(c);
+    if (c == '.')
+    {
+        if ((labellen == 0 || labelhyphen) && labelerror == 0)
+            labelerror = labelhyphen ? pos - 1 : pos;
+        labellen = 0;
+        labelhyphen = false;
+        return;
+    }
+    if (labellen == 0 && c == '-' && labelerror == 0)
+        labelerror = pos;
+    if (labellen < 255)
+        labellen++;
+    if (labellen > labelmax && labelerror == 0)
+        labelerror = pos;
+    labelhyphen = (c == '-');
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::endAuthority()
+{
+    if (atloc != 0)
+    {
+        parts.userinfo.pos = authstart;
+        parts.userinfo.len = atloc - authstart;
+        parts.username = parts.userinfo;
+        if (usercolon != 0 && usercolon < atloc)
+        {
+            parts.username.len = usercolon - authstart;
+            parts.password.pos = usercolon + 1;
+            parts.password.len = atloc - usercolon - 1;
+        }
+    }
+    parts.host.pos = hoststart;
+    if (bracket == 3)
+        parts.host.len = hostend - hoststart;
+    else
+    {
+        parts.host.len = (portcolon != 0 ? portcolon : pos) - hoststart;
+        parts.nonascii = nonascii;
+        if (ipv4.finish(parts.address))
+            parts.hosttype = LCBURL_HOST_IPV4;
+        else if (!nonascii)
+        {
+            // DNS limits, RFC1034 section 3.1; an internationalized name is
+            // checked once it is converted
+            if (labelhyphen && labelerror == 0)
+                labelerror = parts.host.pos + parts.host.len - 1;
+            if (labelerror != 0)
+                return fail(LCBURL_ERR_LABEL, labelerror, LCBURL_COMPONENT_HOST);
+            if (parts.host.len > hostmax)
+                return fail(LCBURL_ERR_HOST_LENGTH, parts.host.pos + hostmax, LCBURL_COMPONENT_HOST);
+        }
+    }
+    if (parts.host.len == 0 && (schemeflags & LCBURL_SCHEME_HOST))
+        return fail(LCBURL_ERR_HOST_EMPTY, parts.host.pos, LCBURL_COMPONENT_HOST);
+    if (portcolon != 0)
+    {
+        parts.port.pos = portcolon + 1;
+        parts.port.len = pos - portcolon - 1;
+        if (portbad)
+            return fail(LCBURL_ERR_PORT, parts.port.pos, LCBURL_COMPONENT_PORT);
+        if (portrange)
+            return fail(LCBURL_ERR_PORT_RANGE, parts.port.pos, LCBURL_COMPONENT_PORT);
+        parts.portnum = portvalue;
+    }
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::startPath(char c) // Path, query or fragment directly after authority/scheme
+{
+    if (c == '?')
+    {
+        parts.query.pos = pos + 1;
+        state = QUERY;
+    }
+    else if (c == '#')
+    {
+        parts.fragment.pos = pos + 1;
+        state = FRAGMENT;
+    }
+    else
+    {
+        if (!isPChar(c) && c != '/' && c != '%')
+            return fail(LCBURL_ERR_CHARACTER);
+        parts.path.pos = pos;
+        state = PATH;
+    }
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::pathChar(char c)
+{
+    if (c == '?')
+    {
+        parts.path.len = pos - parts.path.pos;
+        parts.query.pos = pos + 1;
+        state = QUERY;
+    }
+    else if (c == '#')
+    {
+        parts.path.len = pos - parts.path.pos;
+        parts.fragment.pos = pos + 1;
+        state = FRAGMENT;
+    }
+    else if (!isPChar(c) && c != '/' && c != '%')
+        return fail(LCBURL_ERR_CHARACTER);
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::push(char c) // Advance the state machine by one byte
+{
+    if (state == FAILED)
+        return false;
+    if (pos == UINT16_MAX)
+        return fail(LCBURL_ERR_TOO_LONG);
+
+    if (pct > 0)
+    {
+        // Percent-encoded triplets are opaque to every state
+        if (!isHexChar(c))
+            return fail(LCBURL_ERR_PERCENT);
+        if (zonepct > 0)
+        {
+            // Zone ID delimiter must be "%25"
+            if (c != (zonepct == 2 ? '2' : '5'))
+                return fail(LCBURL_ERR_IP_LITERAL);
+            zonepct--;
+        }
+        pct--;
+        pos++;
+        return true;
+    }
+    if (c == '%')
+    {
+        // A path without an authority may start with a triplet
+        if (state == SCHEME_START || state == SCHEME)
+            return fail(LCBURL_ERR_CHARACTER);
+        if ((state == SLASH || state == AFTER_SCHEME) && (schemeflags & LCBURL_SCHEME_AUTHORITY))
+            return fail(LCBURL_ERR_CHARACTER);
+        pct = 2;
+    }
+
+    switch (state)
+    {
+    case SCHEME_START:
+        if (!isAlphaChar(c))
+            return fail(LCBURL_ERR_SCHEME);
+        scheme[0] = toLowerChar(c);
+        state = SCHEME;
+        break;
+    case SCHEME:
+        if (c == ':')
+        {
+            endScheme();
+            state = AFTER_SCHEME;
+        }
+        else if (isAlphaChar(c) || isDigitChar(c) || c == '+' || c == '-' || c == '.')
+        {
+            // Names longer than the buffer cannot be in the scheme table
+            if (pos < schememax)
+                scheme[pos] = toLowerChar(c);
+        }
+        else
+            return fail(LCBURL_ERR_SCHEME);
+        break;
+    case AFTER_SCHEME:
+        if (c == '/')
+            state = SLASH;
+        else if (schemeflags & LCBURL_SCHEME_AUTHORITY)
+            return fail(LCBURL_ERR_AUTHORITY_REQUIRED);
+        else if (!startPath(c))
+            return false;
+        break;
+    case SLASH:
+        if (c == '/')
+        {
+            parts.authority = true;
+            authstart = pos + 1;
+            hoststart = pos + 1;
+            state = AUTHORITY;
+        }
+        else if (schemeflags & LCBURL_SCHEME_AUTHORITY)
+            return fail(LCBURL_ERR_AUTHORITY_REQUIRED);
+        else
+        {
+            // Path beginning with a single "/"
+            parts.path.pos = pos - 1;
+            state = PATH;
+            if (!pathChar(c))
+                return false;
+        }
+        break;
+    case AUTHORITY:
+        if ((c == '/' || c == '?' || c == '#') && bracket != 1 && bracket != 2)
+        {
+            if (!endAuthority() || !startPath(c))
+                return false;
+        }
+        else
+        {
+            uint8_t error = authorityChar(c);
+            if (error != LCBURL_ERR_NONE)
+                return fail(error);
+        }
+        break;
+    case PATH:
+        if (!pathChar(c))
+            return false;
+        break;
+    case QUERY:
+        if (c == '#')
+        {
+            parts.query.len = pos - parts.query.pos;
+            parts.fragment.pos = pos + 1;
+            state = FRAGMENT;
+        }
+        else if (!isPChar(c) && c != '/' && c != '?' && c != '%')
+            return fail(LCBURL_ERR_CHARACTER);
+        break;
+    case FRAGMENT:
+        if (!isPChar(c) && c != '/' && c != '?' && c != '%')
+            return fail(LCBURL_ERR_CHARACTER);
+        break;
+    case FAILED:
+        return false;
+    }
+    pos++;
+    return true;
+}
+
+LCBURL_CONSTEXPR bool LCBUrlTokenizer::finish() // Close any open component and validate
+{
+    if (state == FAILED)
+        return false;
+    if (pct > 0)
+        return fail(LCBURL_ERR_PERCENT);
+
+    switch (state)
+    {
+    case AFTER_SCHEME:
+        if (schemeflags & LCBURL_SCHEME_AUTHORITY)
+            return fail(LCBURL_ERR_AUTHORITY_REQUIRED);
+        break;
+    case SLASH:
+        if (schemeflags & LCBURL_SCHEME_AUTHORITY)
+            return fail(LCBURL_ERR_AUTHORITY_REQUIRED);
+        parts.path.pos = pos - 1;
+        parts.path.len = 1;
+        break;
+    case AUTHORITY:
+        if (bracket == 1 || bracket == 2)
+            return fail(LCBURL_ERR_IP_LITERAL);
+        if (!endAuthority())
+            return false;
+        break;
+    case PATH:
+        parts.path.len = pos - parts.path.pos;
+        break;
+    case QUERY:
+        parts.query.len = pos - parts.query.pos;
+        break;
+    case FRAGMENT:
+        parts.fragment.len = pos - parts.fragment.pos;
+        break;
+    default:
+        // No scheme
+        return fail((pos == 0) ? LCBURL_ERR_EMPTY : LCBURL_ERR_SCHEME);
+    }
+
+    if (parts.host.len == 0 && (schemeflags & LCBURL_SCHEME_HOST))
+        return fail(LCBURL_ERR_HOST_EMPTY, parts.host.pos, LCBURL_COMPONENT_HOST);
+    parts.valid = true;
+    return true;
+}
+
+#endif // _LCBURL_TOKENIZER_H
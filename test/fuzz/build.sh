@@ -0,0 +1,94 @@
+#!/usr/bin/env bash
+
+# Copyright (C) 2019-2022 Lee C. Bussy (@LBussy)
+
+# This file is part of Lee Bussy's LCBUrl.
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Build the host fuzz target in test/fuzz/build/fuzz_url.  Uses libFuzzer
+# when clang++ is found, otherwise g++ with standalone.cpp.  Both builds
+# use AddressSanitizer, UndefinedBehaviorSanitizer and LCBURL_DEBUG_CHECKS.
+#
+#   test/fuzz/build.sh [-p <git revision>]
+#
+# -p also compares each accepted URL with the library at that revision.
+
+declare FUZZDIR GITROOT BUILDDIR CXX PREVIOUS
+declare -a FLAGS SOURCES
+
+get_dirs() {
+    FUZZDIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+    GITROOT=$(cd "$FUZZDIR/../.." && pwd)
+    BUILDDIR="$FUZZDIR/build"
+    mkdir -p "$BUILDDIR" || exit 1
+}
+
+get_args() {
+    while getopts "p:" opt; do
+        case $opt in
+            p) PREVIOUS="$OPTARG" ;;
+            *) echo "Usage: $0 [-p <git revision>]"; exit 1 ;;
+        esac
+    done
+}
+
+get_compiler() {
+    FLAGS=(-std=c++17 -g -O1 -Wall -Wextra -fno-omit-frame-pointer -DLCBURL_DEBUG_CHECKS -I"$FUZZDIR/shim")
+    SOURCES=("$FUZZDIR/fuzz_url.cpp" "$GITROOT/src/LCBUrl.cpp")
+    if [[ -f $(which clang++ 2>/dev/null) ]]; then
+        CXX=clang++
+        FLAGS+=(-fsanitize=fuzzer,address,undefined)
+    else
+        echo -e "\nclang++ not found, building the standalone driver with g++."
+        CXX=g++
+        FLAGS+=(-fsanitize=address,undefined)
+        SOURCES+=("$FUZZDIR/standalone.cpp")
+    fi
+}
+
+get_previous() {
+    [[ -z "$PREVIOUS" ]] && return
+    local dir="$BUILDDIR/previous" file
+    echo -e "\nExtracting LCBUrl at $PREVIOUS."
+    rm -rf "$dir" && mkdir -p "$dir" || exit 1
+    for file in LCBUrl.h LCBUrl.cpp LCBUrlTokenizer.h; do
+        git -C "$GITROOT" show "$PREVIOUS:src/$file" > "$dir/$file" 2>/dev/null || rm -f "$dir/$file"
+    done
+    [[ -f "$dir/LCBUrl.cpp" ]] || { echo -e "\nERROR: No src/LCBUrl.cpp at $PREVIOUS."; exit 1; }
+    "$CXX" "${FLAGS[@]}" -I"$dir" -w -c "$FUZZDIR/previous.cpp" -o "$BUILDDIR/previous.o" || exit 1
+    FLAGS+=(-DLCBURL_FUZZ_PREVIOUS)
+    SOURCES+=("$BUILDDIR/previous.o")
+}
+
+build_target() {
+    echo -e "\nBuilding $BUILDDIR/fuzz_url with $CXX."
+    "$CXX" "${FLAGS[@]}" -I"$GITROOT/src" "${SOURCES[@]}" -o "$BUILDDIR/fuzz_url" || exit 1
+    echo -e "\nRun with:\n\t$BUILDDIR/fuzz_url -runs=300000 $FUZZDIR/corpus\n"
+}
+
+main() {
+    get_dirs "$@"
+    get_args "$@"
+    get_compiler "$@"
+    get_previous "$@"
+    build_target "$@"
+}
+
+main "$@" && exit 0
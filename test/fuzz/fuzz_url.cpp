@@ -0,0 +1,234 @@
+/*
+    fuzz_url.cpp - libFuzzer target for LCBUrl - Parses each input three
+                   ways (setUrl() from RAM, setUrl() from flash and
+                   LCBUrlParser in pieces) and stops on any disagreement
+                   between them or with a reference RFC3986 splitter.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <LCBUrl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#ifdef LCBURL_FUZZ_PREVIOUS
+// Built by build.sh -p from an earlier revision of the library
+bool previousSetUrl(const char *url, std::string &normal);
+#endif
+
+// The URL split by the regular expression in RFC3986 appendix B, which
+// accepts any string
+struct Reference
+{
+    bool hasScheme = false;
+    bool hasAuthority = false;
+    bool hasQuery = false;
+    bool hasFragment = false;
+    std::string scheme;
+    std::string authority;
+    std::string path;
+    std::string query;
+    std::string fragment;
+};
+
+static Reference split(const std::string &url)
+{
+    Reference retVal;
+    size_t start = 0;
+    size_t stop = url.find_first_of(":/?#");
+    if (stop != std::string::npos && stop > 0 && url[stop] == ':')
+    {
+        retVal.hasScheme = true;
+        retVal.scheme = url.substr(0, stop);
+        start = stop + 1;
+    }
+    if (url.compare(start, 2, "//") == 0)
+    {
+        retVal.hasAuthority = true;
+        stop = url.find_first_of("/?#", start + 2);
+        if (stop == std::string::npos)
+            stop = url.size();
+        retVal.authority = url.substr(start + 2, stop - start - 2);
+        start = stop;
+    }
+    stop = url.find_first_of("?#", start);
+    if (stop == std::string::npos)
+        stop = url.size();
+    retVal.path = url.substr(start, stop - start);
+    start = stop;
+    if (start < url.size() && url[start] == '?')
+    {
+        retVal.hasQuery = true;
+        stop = url.find('#', start);
+        if (stop == std::string::npos)
+            stop = url.size();
+        retVal.query = url.substr(start + 1, stop - start - 1);
+        start = stop;
+    }
+    if (start < url.size())
+    {
+        retVal.hasFragment = true;
+        retVal.fragment = url.substr(start + 1);
+    }
+    return retVal;
+}
+
+static bool isUnreserved(char c)
+{
+    return isalnum((unsigned char)c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = (char)tolower((unsigned char)c);
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+static std::string normalize(const std::string &str)
+{
+    // RFC3986 section 6.2.2: decode unreserved triplets, uppercase others
+    std::string retVal;
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        if (str[i] != '%' || i + 2 >= str.size())
+        {
+            retVal += str[i];
+            continue;
+        }
+        int high = hexValue(str[i + 1]);
+        int low = hexValue(str[i + 2]);
+        char decoded = (char)(high * 16 + low);
+        if (high >= 0 && low >= 0 && isUnreserved(decoded))
+        {
+            retVal += decoded;
+        }
+        else
+        {
+            retVal += '%';
+            retVal += (char)toupper((unsigned char)str[i + 1]);
+            retVal += (char)toupper((unsigned char)str[i + 2]);
+        }
+        i += 2;
+    }
+    return retVal;
+}
+
+static std::string lower(std::string str)
+{
+    for (char &c : str)
+        c = (char)tolower((unsigned char)c);
+    return str;
+}
+
+static void check(bool condition, const char *what, const std::string &input, const String &left, const String &right)
+{
+    if (condition)
+        return;
+    fprintf(stderr, "\n%s\n  input: \"%s\"\n  %s\n  %s\n", what, input.c_str(), left.c_str(), right.c_str());
+    abort();
+}
+
+static void checkErrors(const char *what, const std::string &input, const LCBUrl &left, const LCBUrl &right)
+{
+    String detail = String("error ") + String((unsigned int)left.getError()) + " at " + String((unsigned int)left.getErrorPosition());
+    String other = String("error ") + String((unsigned int)right.getError()) + " at " + String((unsigned int)right.getErrorPosition());
+    check(left.getError() == right.getError() && left.getErrorPosition() == right.getErrorPosition(), what, input, detail, other);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // URLs are C strings; anything after a '\0' is not part of one
+    std::string input(reinterpret_cast<const char *>(data), size);
+    input = input.substr(0, strlen(input.c_str()));
+
+    LCBUrl url;
+    bool valid = url.setUrl(String(input.c_str()));
+
+    // The same URL read in place from flash
+    LCBUrl flash;
+    bool flashValid = flash.setUrl(F(input.c_str()));
+    check(valid == flashValid && url.getUrl() == flash.getUrl(), "setUrl(F()) differs", input, url.getUrl(), flash.getUrl());
+    checkErrors("setUrl(F()) error differs", input, url, flash);
+
+    // The same URL pushed in pieces whose sizes come from the input
+    LCBUrl pieces;
+    LCBUrlParser parser(pieces);
+    uint32_t state = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        state = (state ^ data[i]) * 16777619u;
+    for (size_t start = 0; start < input.size();)
+    {
+        state = state * 1103515245u + 12345u;
+        size_t length = 1 + (state >> 16) % 7;
+        if (length > input.size() - start)
+            length = input.size() - start;
+        parser.push(input.c_str() + start, length);
+        start += length;
+    }
+    bool piecesValid = parser.finish();
+    if (!input.empty())
+    {
+        check(valid == piecesValid && url.getUrl() == pieces.getUrl(), "LCBUrlParser differs", input, url.getUrl(), pieces.getUrl());
+        checkErrors("LCBUrlParser error differs", input, url, pieces);
+    }
+
+#ifdef LCBURL_FUZZ_PREVIOUS
+    std::string previous;
+    if (valid && previousSetUrl(input.c_str(), previous))
+        check(previous == url.getUrl().c_str(), "Previous LCBUrl differs", input, String(previous.c_str()), url.getUrl());
+#endif
+
+    if (!valid)
+    {
+        check(url.getError() != LCBURL_ERR_NONE && url.getErrorPosition() <= input.size(), "Rejected without a reason", input, url.getErrorString(), String((unsigned int)url.getErrorPosition()));
+        return 0;
+    }
+
+    // The input and the normalized URL split the same way, and the getters
+    // return the pieces of the normalized URL.  getUrl() drops the "?" or
+    // "#" of an empty query or fragment, and writes an empty path after an
+    // authority as "/" (RFC3986 section 6.2.3).
+    Reference raw = split(input);
+    String normal = url.getUrl();
+    Reference out = split(normal.c_str());
+    for (unsigned int i = 0; i + 2 < normal.length(); i++)
+    {
+        if (normal.charAt(i) != '%')
+            continue;
+        check(hexValue(normal.charAt(i + 1)) < 0 || hexValue(normal.charAt(i + 2)) < 0 || (!islower((unsigned char)normal.charAt(i + 1)) && !islower((unsigned char)normal.charAt(i + 2))), "Triplet not uppercase", input, normal, String(""));
+    }
+    check(raw.hasScheme && out.scheme == lower(raw.scheme) && url.getScheme() == out.scheme.c_str(), "Scheme differs from reference", input, url.getScheme(), normal);
+    check(raw.hasAuthority == out.hasAuthority && url.getAuthority() == out.authority.c_str(), "Authority differs from reference", input, url.getAuthority(), normal);
+    check((raw.hasQuery && !raw.query.empty()) == out.hasQuery && out.query == normalize(raw.query) && url.getQuery() == out.query.c_str(), "Query differs from reference", input, url.getQuery(), normal);
+    std::string path = normalize(raw.path);
+    if (path.empty() && raw.hasAuthority)
+        path = "/";
+    check(out.path == path, "Path differs from reference", input, String(path.c_str()), normal);
+    check((raw.hasFragment && !raw.fragment.empty()) == out.hasFragment && out.fragment == normalize(raw.fragment) && url.getFragment() == out.fragment.c_str(), "Fragment differs from reference", input, url.getFragment(), normal);
+    return 0;
+}
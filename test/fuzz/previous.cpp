@@ -0,0 +1,53 @@
+/*
+    previous.cpp - An earlier revision of LCBUrl for the differential mode
+                   of fuzz_url.cpp - build.sh -p extracts that revision's
+                   sources, which are compiled here inside a namespace so
+                   they can be linked next to the current library.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Everything the old sources include, so their own includes are no-ops
+// inside the namespace
+#include <Arduino.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace lcburl_previous
+{
+#include "LCBUrl.cpp"
+}
+
+bool previousSetUrl(const char *url, std::string &normal)
+{
+    lcburl_previous::LCBUrl previous;
+    bool retVal = previous.setUrl(String(url));
+    normal = previous.getUrl().c_str();
+    return retVal;
+}
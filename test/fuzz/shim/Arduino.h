@@ -0,0 +1,214 @@
+/*
+    Arduino.h - Host (native) stand-in for the parts of the Arduino core
+                used by LCBUrl, so the library can be built and fuzzed on
+                a PC.  Not for use on a board.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef _LCBURL_SHIM_ARDUINO_H
+#define _LCBURL_SHIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <string>
+
+// Flash is ordinary memory on a host
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define PROGMEM
+#define PGM_P const char *
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+class String
+{
+public:
+    String() {}
+    String(const char *str) : s(str ? str : "") {}
+    String(const __FlashStringHelper *str) : s(reinterpret_cast<const char *>(str)) {}
+    String(char c) : s(1, c) {}
+    explicit String(int value) : s(std::to_string(value)) {}
+    explicit String(unsigned int value) : s(std::to_string(value)) {}
+    unsigned int length() const { return (unsigned int)s.size(); }
+    const char *c_str() const { return s.c_str(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size)
+    {
+        s.reserve(size);
+        return true;
+    }
+    bool concat(const String &str)
+    {
+        s += str.s;
+        return true;
+    }
+    bool concat(const char *str)
+    {
+        s += str;
+        return true;
+    }
+    bool concat(const __FlashStringHelper *str)
+    {
+        s += reinterpret_cast<const char *>(str);
+        return true;
+    }
+    bool concat(char c)
+    {
+        s += c;
+        return true;
+    }
+    bool concat(int value)
+    {
+        s += std::to_string(value);
+        return true;
+    }
+    bool concat(unsigned int value)
+    {
+        s += std::to_string(value);
+        return true;
+    }
+    char charAt(unsigned int index) const { return (index < s.size()) ? s[index] : '\0'; }
+    void setCharAt(unsigned int index, char c)
+    {
+        if (index < s.size())
+            s[index] = c;
+    }
+    String substring(unsigned int from) const { return (from < s.size()) ? String(s.substr(from).c_str()) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+        {
+            unsigned int temp = from;
+            from = to;
+            to = temp;
+        }
+        if (from >= s.size())
+            return String();
+        return String(s.substr(from, to - from).c_str());
+    }
+    int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return position(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return position(s.rfind(c)); }
+    int lastIndexOf(const String &str) const { return position(s.rfind(str.s)); }
+    int lastIndexOf(const String &str, unsigned int from) const { return position(s.rfind(str.s, from)); }
+    bool startsWith(const String &str) const { return s.compare(0, str.s.size(), str.s) == 0; }
+    bool endsWith(const String &str) const { return s.size() >= str.s.size() && s.compare(s.size() - str.s.size(), str.s.size(), str.s) == 0; }
+    bool equalsIgnoreCase(const String &str) const { return strcasecmp(s.c_str(), str.s.c_str()) == 0; }
+    void toLowerCase()
+    {
+        for (char &c : s)
+            c = (char)tolower((unsigned char)c);
+    }
+    void toUpperCase()
+    {
+        for (char &c : s)
+            c = (char)toupper((unsigned char)c);
+    }
+    void remove(unsigned int index)
+    {
+        if (index < s.size())
+            s.erase(index);
+    }
+    long toInt() const { return atol(s.c_str()); }
+    explicit operator bool() const { return true; } // A String which exists, as in the core
+    bool operator==(const String &str) const { return s == str.s; }
+    bool operator==(const char *str) const { return s == str; }
+    bool operator!=(const String &str) const { return s != str.s; }
+    bool operator<(const String &str) const { return s < str.s; }
+    String operator+(const String &str) const { return String((s + str.s).c_str()); }
+    String operator+(const char *str) const { return String((s + str).c_str()); }
+    String operator+(char c) const { return String((s + c).c_str()); }
+
+private:
+    static int position(size_t found) { return (found == std::string::npos) ? -1 : (int)found; }
+    std::string s;
+};
+
+class IPAddress
+{
+public:
+    IPAddress() {}
+    IPAddress(uint32_t address) { memcpy(bytes, &address, 4); }
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+    {
+        bytes[0] = first;
+        bytes[1] = second;
+        bytes[2] = third;
+        bytes[3] = fourth;
+    }
+    bool operator==(const IPAddress &address) const { return memcmp(bytes, address.bytes, 4) == 0; }
+    bool operator!=(const IPAddress &address) const { return !(*this == address); }
+    uint8_t operator[](int index) const { return bytes[index]; }
+    bool fromString(const char *address)
+    {
+        unsigned int parts[4];
+        char extra;
+        if (sscanf(address, "%u.%u.%u.%u%c", &parts[0], &parts[1], &parts[2], &parts[3], &extra) != 4)
+            return false;
+        for (int i = 0; i < 4; i++)
+        {
+            if (parts[i] > 255)
+                return false;
+            bytes[i] = (uint8_t)parts[i];
+        }
+        return true;
+    }
+    String toString() const
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return String(buffer);
+    }
+
+private:
+    uint8_t bytes[4] = {};
+};
+
+#define INADDR_NONE ((uint32_t)0xffffffffUL)
+
+inline bool isAlphaNumeric(int c) { return isalnum(c) != 0; }
+
+// Name lookups are never made by the fuzz target; any that are fail
+class WiFiClass
+{
+public:
+    int hostByName(const char *, IPAddress &address)
+    {
+        address = IPAddress(INADDR_NONE);
+        return 0;
+    }
+};
+static WiFiClass WiFi __attribute__((unused));
+
+#endif // _LCBURL_SHIM_ARDUINO_H
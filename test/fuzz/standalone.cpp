@@ -0,0 +1,131 @@
+/*
+    standalone.cpp - Driver for fuzz_url.cpp where libFuzzer is not
+                     available (GCC) - Replays the files named on the
+                     command line, then mutates them for -runs=N inputs.
+*/
+
+/*
+    MIT License
+
+    Copyright (c) 2019-2022 Lee C. Bussy
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Bytes worth inserting into a URL
+static const char alphabet[] = "abcXYZ019:/?#[]@%-._~!$&'()*+,;=25fe \x80\xc3\xbc";
+
+static bool readFile(const std::string &path, std::vector<std::string> &inputs)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    std::string input;
+    char buffer[1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        input.append(buffer, length);
+    fclose(file);
+    inputs.push_back(input);
+    return true;
+}
+
+static void readPath(const std::string &path, std::vector<std::string> &inputs)
+{
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL)
+    {
+        if (!readFile(path, inputs))
+            fprintf(stderr, "Unable to read %s\n", path.c_str());
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+            readFile(path + "/" + entry->d_name, inputs);
+    }
+    closedir(dir);
+}
+
+static void run(const std::string &input)
+{
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+}
+
+int main(int argc, char **argv)
+{
+    long runs = 0;
+    unsigned int seed = 1;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+            runs = atol(argv[i] + 6);
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+            seed = (unsigned int)atol(argv[i] + 6);
+        else if (argv[i][0] != '-')
+            readPath(argv[i], inputs);
+    }
+    for (const std::string &input : inputs)
+        run(input);
+    printf("Replayed %u inputs\n", (unsigned int)inputs.size());
+    if (inputs.empty())
+        inputs.push_back("http://example.com/");
+
+    // One to four random inserts, deletes or replacements of a corpus entry
+    srand(seed);
+    for (long i = 0; i < runs; i++)
+    {
+        std::string input = inputs[rand() % inputs.size()];
+        int mutations = 1 + rand() % 4;
+        for (int m = 0; m < mutations; m++)
+        {
+            size_t position = (size_t)rand() % (input.size() + 1);
+            char c = alphabet[rand() % (sizeof(alphabet) - 1)];
+            switch (rand() % 3)
+            {
+            case 0:
+                input.insert(position, 1, c);
+                break;
+            case 1:
+                if (position < input.size())
+                    input.erase(position, 1);
+                break;
+            default:
+                if (position < input.size())
+                    input[position] = c;
+                break;
+            }
+        }
+        run(input);
+    }
+    printf("Ran %ld mutated inputs\n", runs);
+    return 0;
+}